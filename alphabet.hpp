@@ -0,0 +1,393 @@
+// Gesture alphabets loaded from files at run time, compiled into the same dense tables as the built-in one.
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <ostream>
+#include <sstream>
+#include <stdexcept>
+#include <stdint.h>
+#include <string>
+#include <sys/stat.h>
+#include <utility>
+
+#include "letter-table.hpp"
+
+// What a gesture does. Letters, punctuation and the space are appended to the word; the commands act on it.
+enum GestureAction {
+	actionNone,
+	actionLetter,
+	actionBackspace,
+	actionClear,
+	actionSendEmail,
+	actionSendSms
+};
+
+struct GestureSymbol {
+	uint8_t action;
+	char letter;
+};
+
+// The names commands have in alphabet files, indexed by GestureAction.
+const char* const gestureActionNames[] = { "", "", "backspace", "clear", "email", "sms" };
+
+// AlphabetIndex is a compiled alphabet: a symbol for every gesture code, and for every code taken as a prefix, how
+// many symbols it could still become and the one it must become when there is only one. Lookups are a single array
+// access.
+class AlphabetIndex {
+public:
+	AlphabetIndex()
+	{
+		for (unsigned code = 0; code < gestureCodeCount; ++code) {
+			symbols[code] = noSymbol();
+			completions[code] = noSymbol();
+			candidates[code] = 0;
+		}
+	}
+
+	// builtIn() is the alphabet of letterEntries in letter-table.hpp, used when no file has been loaded.
+	static const AlphabetIndex& builtIn()
+	{
+		static const AlphabetIndex index = compileBuiltIn();
+		return index;
+	}
+
+	GestureSymbol symbolFor(unsigned code) const
+	{
+		return code < gestureCodeCount ? symbols[code] : noSymbol();
+	}
+
+	// candidatesFor() is 0 if no symbol's gesture starts with the prefix, 1 if only one symbol's does, and more
+	// otherwise, though beyond 1 it may count a symbol more than once.
+	unsigned candidatesFor(unsigned prefix) const
+	{
+		return prefix < gestureCodeCount ? candidates[prefix] : 0;
+	}
+
+	// completionFor() returns the symbol a prefix can only become, or no symbol while it is still ambiguous.
+	GestureSymbol completionFor(unsigned prefix) const
+	{
+		return prefix < gestureCodeCount ? completions[prefix] : noSymbol();
+	}
+
+	// describeCandidates() prints the symbols a prefix could still become, commands by name.
+	void describeCandidates(unsigned prefix, std::ostream& out) const
+	{
+		for (unsigned code = prefix; code < gestureCodeCount; ++code) {
+			if (symbols[code].action != actionNone && hasPrefix(code, prefix)) {
+				out << ' ';
+				describe(symbols[code], out);
+			}
+		}
+	}
+
+	static void describe(GestureSymbol symbol, std::ostream& out)
+	{
+		if (symbol.action == actionLetter) {
+			out << symbol.letter;
+		}
+		else {
+			out << '[' << gestureActionNames[symbol.action] << ']';
+		}
+	}
+
+	// isFree() is true if no code that define() would give a symbol to has one yet.
+	bool isFree(unsigned code, unsigned eitherWay) const
+	{
+		for (unsigned directions = eitherWay;; directions = (directions - 1) & eitherWay) {
+			if (symbols[(code & ~eitherWay) | directions].action != actionNone) {
+				return false;
+			}
+			if (directions == 0) {
+				return true;
+			}
+		}
+	}
+
+	// define() gives a gesture code a symbol. The strokes whose direction bits are set in `eitherWay` may go either
+	// way, so the symbol goes to every code they make in any combination of directions. The caller has checked with
+	// isFree() that those codes are free.
+	void define(unsigned code, GestureSymbol symbol, unsigned eitherWay = 0)
+	{
+		for (unsigned directions = eitherWay;; directions = (directions - 1) & eitherWay) {
+			symbols[(code & ~eitherWay) | directions] = symbol;
+			if (directions == 0) {
+				return;
+			}
+		}
+	}
+
+	// buildPrefixes() fills in the prefix tables once every symbol has been defined.
+	void buildPrefixes()
+	{
+		for (unsigned prefix = 0; prefix < gestureCodeCount; ++prefix) {
+			candidates[prefix] = 0;
+			completions[prefix] = noSymbol();
+		}
+		for (unsigned code = 0; code < gestureCodeCount; ++code) {
+			if (symbols[code].action == actionNone) {
+				continue;
+			}
+			// The prefixes of a code are the code with its last strokes dropped, down to the empty gesture. A symbol
+			// that went to several codes, one per direction, counts once as long as no other shares the prefix.
+			for (unsigned prefix = code;; prefix >>= strokeBits) {
+				if (candidates[prefix] == 0) {
+					candidates[prefix] = 1;
+					completions[prefix] = symbols[code];
+				}
+				else if (candidates[prefix] > 1 || !sameSymbol(completions[prefix], symbols[code])) {
+					if (candidates[prefix] < 255) {
+						++candidates[prefix];
+					}
+					completions[prefix] = noSymbol();
+				}
+				if (prefix == 0) {
+					break;
+				}
+			}
+		}
+	}
+
+	static GestureSymbol noSymbol()
+	{
+		GestureSymbol symbol = { actionNone, '\0' };
+		return symbol;
+	}
+
+	static bool sameSymbol(GestureSymbol first, GestureSymbol second)
+	{
+		return first.action == second.action && first.letter == second.letter;
+	}
+
+private:
+	static AlphabetIndex compileBuiltIn()
+	{
+		AlphabetIndex index;
+		for (unsigned i = 0; i < letterEntryCount; ++i) {
+			GestureSymbol symbol = { actionLetter, letterEntries[i].letter };
+			const LetterEntry& entry = letterEntries[i];
+			index.define(entry.code, symbol, entry.directed ? 0 : directionBitsOf(entry.code));
+		}
+		index.buildPrefixes();
+		return index;
+	}
+
+	GestureSymbol symbols[gestureCodeCount];
+	GestureSymbol completions[gestureCodeCount];
+	uint8_t candidates[gestureCodeCount];
+};
+
+// compileAlphabet() reads an alphabet file and compiles it. Each line gives a symbol and then its strokes:
+//
+//     a          pitch yaw pitch
+//     .          yaw+ yaw-
+//     space
+//     backspace  pitch pitch pitch pitch
+//
+// A stroke is roll, pitch or yaw, in either direction, or one of them followed by + or - for the direction it must go
+// (see Stroke). A symbol is any single printable character, "space", or one of the commands backspace, clear, email and
+// sms. Blank lines and lines starting with # are ignored. It throws std::runtime_error, naming the line, if the file
+// can't be read, a line doesn't parse, a gesture has more than maxGestureStrokes strokes, or two symbols share a
+// gesture in some direction.
+inline std::unique_ptr<AlphabetIndex> compileAlphabet(const std::string& path)
+{
+	std::ifstream input(path.c_str());
+	if (!input) {
+		throw std::runtime_error("Unable to open alphabet " + path);
+	}
+	std::unique_ptr<AlphabetIndex> index(new AlphabetIndex());
+	std::string line;
+	for (unsigned number = 1; std::getline(input, line); ++number) {
+		std::istringstream fields(line);
+		std::string name;
+		if (!(fields >> name) || name[0] == '#') {
+			continue;
+		}
+		std::ostringstream where;
+		where << path << ':' << number << ": ";
+
+		GestureSymbol symbol = { actionLetter, name[0] };
+		if (name == "space") {
+			symbol.letter = ' ';
+		}
+		else if (name.size() > 1) {
+			symbol.action = actionNone;
+			for (unsigned action = actionBackspace; action <= actionSendSms; ++action) {
+				if (name == gestureActionNames[action]) {
+					symbol.action = static_cast<uint8_t>(action);
+					symbol.letter = '\0';
+				}
+			}
+			if (symbol.action == actionNone) {
+				throw std::runtime_error(where.str() + "unknown symbol " + name);
+			}
+		}
+
+		unsigned code = 0, eitherWay = 0, count = 0;
+		std::string word;
+		while (fields >> word) {
+			Stroke stroke = word == "roll" ? strokeRoll : word == "pitch" ? strokePitch : word == "yaw" ? strokeYaw
+				: strokeNone;
+			bool directed = stroke == strokeNone;
+			for (unsigned named = strokeRoll; directed && named <= strokeYawNegative; ++named) {
+				if (word == strokeNames[named]) {
+					stroke = static_cast<Stroke>(named);
+				}
+			}
+			if (stroke == strokeNone) {
+				throw std::runtime_error(where.str() + "unknown stroke " + word);
+			}
+			if (++count > maxGestureStrokes) {
+				throw std::runtime_error(where.str() + "gestures have at most four strokes");
+			}
+			code = appendStroke(code, stroke);
+			eitherWay = (eitherWay << strokeBits) | (directed ? 0 : strokeNegative);
+		}
+		if (!index->isFree(code, eitherWay)) {
+			throw std::runtime_error(where.str() + "this gesture is already taken");
+		}
+		index->define(code, symbol, eitherWay);
+	}
+	index->buildPrefixes();
+	return index;
+}
+
+// AlphabetSlot is where a recognizer finds its alphabet. The index it points to can be replaced at any time by another
+// thread; current() is a single acquire load, so a recognizer takes it once per lookup and never sees half of an
+// alphabet.
+class AlphabetSlot {
+public:
+	AlphabetSlot()
+		: index(&AlphabetIndex::builtIn())
+	{
+	}
+
+	// builtIn() is a slot that always holds the built-in alphabet.
+	static const AlphabetSlot& builtIn()
+	{
+		static const AlphabetSlot slot;
+		return slot;
+	}
+
+	const AlphabetIndex& current() const
+	{
+		return *index.load(std::memory_order_acquire);
+	}
+
+	void publish(const AlphabetIndex* replacement)
+	{
+		index.store(replacement, std::memory_order_release);
+	}
+
+private:
+	AlphabetSlot(const AlphabetSlot&);
+	AlphabetSlot& operator=(const AlphabetSlot&);
+
+	std::atomic<const AlphabetIndex*> index;
+};
+
+// AlphabetLibrary holds the alphabet files given for each user, plus a default one for everyone else, and reloads a
+// file when it changes. Recognizers use an index without any locking or reference counting, so an index that has
+// been replaced can't be freed at once: a recognizer may be in the middle of a lookup in it. A recognizer only holds
+// on to an index for the length of one lookup, a few microseconds, so replaced indexes are kept for retirementDelay
+// and then freed. A compiled index is 20 kilobytes, so even a file rewritten every second costs about 200 kilobytes.
+// load() and reloadChanged() must be called from one thread.
+class AlphabetLibrary {
+public:
+	static const unsigned retirementDelay = 10;
+
+	// load() compiles an alphabet file for a user, or for everyone without their own if `user` is empty, and throws
+	// std::runtime_error if it doesn't compile.
+	void load(const std::string& user, const std::string& path)
+	{
+		Entry& entry = entries[user];
+		if (!entry.slot) {
+			entry.slot.reset(new AlphabetSlot());
+		}
+		entry.path = path;
+		entry.modified = modificationTime(path);
+		publish(entry, compileAlphabet(path));
+	}
+
+	// slotFor() returns the slot a user's recognizers look their alphabet up in. It stays valid as long as the
+	// library, whatever is loaded into it later.
+	const AlphabetSlot& slotFor(const std::string& user) const
+	{
+		std::map<std::string, Entry>::const_iterator entry = entries.find(user);
+		if (entry == entries.end()) {
+			entry = entries.find(std::string());
+		}
+		return entry != entries.end() ? *entry->second.slot : AlphabetSlot::builtIn();
+	}
+
+	// reloadChanged() recompiles every file that has been modified since it was loaded. A file that no longer compiles
+	// is reported to `log` and the alphabet it had stays in use. It also frees the indexes retired long enough ago.
+	void reloadChanged(std::ostream& log)
+	{
+		freeRetired();
+		for (std::map<std::string, Entry>::iterator i = entries.begin(); i != entries.end(); ++i) {
+			Entry& entry = i->second;
+			long long modified = modificationTime(entry.path);
+			if (modified == entry.modified) {
+				continue;
+			}
+			entry.modified = modified;
+			try {
+				publish(entry, compileAlphabet(entry.path));
+				log << "Reloaded alphabet " << entry.path << std::endl;
+			}
+			catch (const std::exception& e) {
+				log << "Keeping the previous alphabet: " << e.what() << std::endl;
+			}
+		}
+	}
+
+private:
+	struct Entry {
+		std::string path;
+		long long modified;
+		std::unique_ptr<AlphabetSlot> slot;
+		// The index the slot points to.
+		std::unique_ptr<AlphabetIndex> index;
+	};
+
+	struct Retired {
+		std::unique_ptr<AlphabetIndex> index;
+		std::chrono::steady_clock::time_point since;
+	};
+
+	void publish(Entry& entry, std::unique_ptr<AlphabetIndex> index)
+	{
+		entry.slot->publish(index.get());
+		if (entry.index) {
+			Retired replaced;
+			replaced.index = std::move(entry.index);
+			replaced.since = std::chrono::steady_clock::now();
+			retired.push_back(std::move(replaced));
+		}
+		entry.index = std::move(index);
+	}
+
+	void freeRetired()
+	{
+		std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+		while (!retired.empty()
+			&& now - retired.front().since >= std::chrono::seconds(static_cast<int>(retirementDelay))) {
+			retired.pop_front();
+		}
+	}
+
+	static long long modificationTime(const std::string& path)
+	{
+		struct stat status;
+		return stat(path.c_str(), &status) == 0 ? static_cast<long long>(status.st_mtime) : -1;
+	}
+
+	std::map<std::string, Entry> entries;
+	// Replaced indexes, oldest first.
+	std::deque<Retired> retired;
+};
@@ -0,0 +1,219 @@
+// What recognition does with each sample of an armband, free of the Myo SDK types, so that DataCollector, the dataset
+// decoder and the benchmark all run the same code.
+#pragma once
+
+#include <cstring>
+#include <iostream>
+#include <stdint.h>
+
+#include "alphabet.hpp"
+#include "recognizer.hpp"
+#include "seqlock.hpp"
+#include "word-dictionary.hpp"
+
+// The myo::Pose::Type values recognition treats specially. hello-myo.cpp checks them against the SDK's.
+const uint16_t poseRest = 0;
+const uint16_t poseFist = 1;
+const uint16_t poseWaveIn = 2;
+const uint16_t poseWaveOut = 3;
+const uint16_t poseFingersSpread = 4;
+const uint16_t poseUnknown = 0xffff;
+
+// takePoseChange() makes `pose` an armband's current pose and returns true, or returns false if it already was. Only a
+// change of pose is an event for recognition, but a Myo may report the pose it is in again, and sessions record those
+// repeats like any other pose event, so everything that recognizes poses drops them here. Pose is the myo::Pose in
+// DataCollector and the pose type everywhere else; an armband starts out at poseUnknown, like a default myo::Pose.
+template<typename Pose>
+bool takePoseChange(Pose& current, const Pose& pose)
+{
+	if (pose == current) {
+		return false;
+	}
+	current = pose;
+	return true;
+}
+
+// RecognitionSample is the compact copy of an armband's state that an event hands to its recognizer. In pipeline
+// mode these are queued to the recognition thread, so they carry everything recognizeSample() needs.
+struct RecognitionSample {
+	enum Kind {
+		sampleOrientation,
+		samplePose,
+		sampleGyroscope,
+		sampleReset
+	};
+
+	uint8_t kind;
+	uint8_t armband;
+	bool onArm;
+	// The myo::Arm and myo::Pose::Type of the armband.
+	uint8_t arm;
+	uint16_t pose;
+	uint64_t timestamp;
+	float roll_w, pitch_w, yaw_w;
+
+	// The angular velocity in degrees per second, in gyroscope samples.
+	float rates[3];
+
+	// probeClock() time at which the event arrived, or 0 if latency probes were off.
+	int64_t received;
+};
+
+// RecognitionOutcome is what a sample did, for whoever handed it to recognizeSample() to follow up on.
+struct RecognitionOutcome {
+	RecognitionOutcome()
+		: strokeEnded(false), action(actionNone), appendedFrom(0), redraw(false)
+	{
+	}
+
+	// Set if the sample ended a stroke: the arm got back home or, with fusion, stopped.
+	bool strokeEnded;
+
+	// The symbol the sample entered, or actionNone. The fingersSpread and waveOut poses send the word by email and
+	// SMS, and show up here as actionSendEmail and actionSendSms.
+	GestureAction action;
+
+	// Where the characters the sample appended to the word start. It is the length of the word if none were.
+	unsigned appendedFrom;
+
+	// Set if the recognizer echoed something to std::cout, so the status line has to be drawn again.
+	bool redraw;
+};
+
+// followLetter() follows up on a letter or command the recognizer may just have entered, which a fist or, with
+// incremental decoding, a stroke can do. `length` is the length of the word before.
+template<typename Classifier>
+void followLetter(BasicRecognizer<Classifier>& recognizer, WordPredictor& predictor, unsigned length,
+	RecognitionOutcome& outcome)
+{
+	outcome.action = recognizer.takeAction();
+	if (outcome.action == actionBackspace || outcome.action == actionClear) {
+		// The predictor only moves forward, so it follows the last word again from the start.
+		predictor.reset();
+		const char* text = recognizer.word.c_str();
+		const char* lastWord = std::strrchr(text, ' ');
+		for (const char* letter = lastWord ? lastWord + 1 : text; *letter; ++letter) {
+			predictor.advance(*letter);
+		}
+	}
+	else if (outcome.action != actionSendEmail && outcome.action != actionSendSms
+		&& recognizer.word.size() > length) {
+		predictor.advance(recognizer.word.c_str()[length]);
+		if (recognizer.verbose && predictor.suggestion()) {
+			std::cout << "suggestion: " << predictor.suggestion() << '\n';
+		}
+	}
+}
+
+// acceptSuggestion() finishes the word being typed with the predictor's suggestion and a space.
+template<typename Classifier>
+void acceptSuggestion(BasicRecognizer<Classifier>& recognizer, WordPredictor& predictor, RecognitionOutcome& outcome)
+{
+	const char* suggestion = predictor.suggestion();
+	if (!suggestion) {
+		return;
+	}
+	for (const char* letter = suggestion + predictor.prefixLength(); *letter; ++letter) {
+		recognizer.word.append(*letter);
+	}
+	recognizer.word.append(' ');
+	predictor.reset();
+	if (recognizer.verbose) {
+		std::cout << recognizer.word.c_str() << '\n';
+		outcome.redraw = true;
+	}
+}
+
+// recognizeSample() runs an armband's recognizer, and the predictor that follows its words, against one sample. Fists
+// enter letters; fingersSpread, waveOut and waveIn act on the pose event itself, and the orientation samples that
+// arrive while the pose is held are ignored; every other sample is tracked as part of a stroke.
+template<typename Classifier>
+RecognitionOutcome recognizeSample(BasicRecognizer<Classifier>& recognizer, WordPredictor& predictor,
+	const RecognitionSample& sample)
+{
+	RecognitionOutcome outcome;
+	if (sample.kind == RecognitionSample::sampleReset) {
+		recognizer.reset();
+		predictor.reset();
+		return outcome;
+	}
+
+	recognizer.advanceClock(sample.timestamp);
+	unsigned length = recognizer.word.size();
+	outcome.appendedFrom = length;
+	if (!sample.onArm) {
+		return outcome;
+	}
+
+	bool tracking = recognizer.segmentState == BasicRecognizer<Classifier>::segmentTracking;
+	if (sample.kind == RecognitionSample::sampleGyroscope) {
+		recognizer.trackMotion(sample.rates, sample.timestamp);
+	}
+	else if (sample.pose == poseFist) {
+		bool coolingDown = recognizer.segmentState == BasicRecognizer<Classifier>::segmentCooldown;
+		recognizer.confirmLetter(sample.roll_w, sample.pitch_w, sample.yaw_w);
+		followLetter(recognizer, predictor, length, outcome);
+		outcome.redraw = !coolingDown && recognizer.verbose;
+		return outcome;
+	}
+	else if (sample.pose == poseFingersSpread || sample.pose == poseWaveOut || sample.pose == poseWaveIn) {
+		if (sample.kind != RecognitionSample::samplePose) {
+			return outcome;
+		}
+		if (sample.pose == poseWaveIn) {
+			acceptSuggestion(recognizer, predictor, outcome);
+		}
+		else {
+			outcome.action = sample.pose == poseFingersSpread ? actionSendEmail : actionSendSms;
+		}
+		return outcome;
+	}
+	else {
+		recognizer.trackStroke(sample.roll_w, sample.pitch_w, sample.yaw_w);
+	}
+
+	if (tracking && recognizer.segmentState == BasicRecognizer<Classifier>::segmentCooldown) {
+		outcome.strokeEnded = true;
+		followLetter(recognizer, predictor, length, outcome);
+		outcome.redraw = recognizer.verbose;
+	}
+	return outcome;
+}
+
+// TextPublisher publishes an armband's word for any thread to read, see DataCollector::TextState. publish() is called
+// by the thread running recognition after every sample, and stores the word only when the sample changed it. Every
+// gesture and command changes the length of the word, so the length tells when.
+template<unsigned Capacity>
+class TextPublisher {
+public:
+	struct State {
+		unsigned length;
+		char word[Capacity + 1];
+	};
+
+	TextPublisher()
+		: published(0)
+	{
+	}
+
+	void publish(const WordBuffer<Capacity>& word)
+	{
+		if (word.size() == published) {
+			return;
+		}
+		published = word.size();
+		State text;
+		text.length = word.size();
+		std::memcpy(text.word, word.c_str(), text.length + 1);
+		state.store(text);
+	}
+
+	State load() const
+	{
+		return state.load();
+	}
+
+private:
+	Seqlock<State> state;
+	unsigned published;
+};
@@ -0,0 +1,554 @@
+// Benchmark of the recognition hot path: orientation conversion and filtering, segmentation, letter decoding and
+// publishing the text. It drives synthetic or recorded event streams through recognizeSample() and the other code
+// DataCollector runs for each event, under each of the recognizer's options, and checks that the synthetic streams
+// decode to the letters they spell. It needs neither the Myo SDK nor a Myo, so it builds anywhere (see Makefile) as
+// well as from the Visual Studio solution.
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <new>
+#include <stdexcept>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "armband-recognition.hpp"
+#include "dtw-classifier.hpp"
+#include "mapped-file.hpp"
+#include "orientation.hpp"
+#include "orientation-filters.hpp"
+#include "recognizer.hpp"
+#include "session-recorder.hpp"
+
+// Every allocation in the process goes through these, so we can tell how many the recognizer makes per letter. Both
+// forms of new go through allocate(), which lets the compiler see that every delete frees what malloc() returned.
+static std::atomic<unsigned long long> allocationCount(0);
+
+static void* allocate(std::size_t size)
+{
+	++allocationCount;
+	if (void* memory = std::malloc(size ? size : 1)) {
+		return memory;
+	}
+	throw std::bad_alloc();
+}
+
+void* operator new(std::size_t size)
+{
+	return allocate(size);
+}
+
+void* operator new[](std::size_t size)
+{
+	return allocate(size);
+}
+
+void operator delete(void* memory) noexcept
+{
+	std::free(memory);
+}
+
+void operator delete[](void* memory) noexcept
+{
+	std::free(memory);
+}
+
+void operator delete(void* memory, std::size_t) noexcept
+{
+	std::free(memory);
+}
+
+void operator delete[](void* memory, std::size_t) noexcept
+{
+	std::free(memory);
+}
+
+// BenchmarkEvent is one event of a stream, reduced to what recognition looks at.
+struct BenchmarkEvent {
+	enum Kind {
+		eventOrientation,
+		eventGyroscope,
+		eventPose,
+		eventArmSync,
+		eventArmUnsync
+	};
+
+	uint8_t kind;
+	uint8_t armband;
+	uint16_t pose;
+	uint64_t timestamp;
+
+	// The quaternion of an orientation event, or the angular velocity about x, y and z of a gyroscope one.
+	float x, y, z, w;
+};
+
+// BenchmarkSettings is one way of running the recognizer, with the options the application has for it.
+struct BenchmarkSettings {
+	const char* name;
+	bool fastEuler;
+	// Run the orientation through the median and 1€ filters, as --filter median,one-euro does.
+	bool filtered;
+	bool calibrating;
+	bool incremental;
+	bool fusion;
+};
+
+const BenchmarkSettings benchmarkSettings[] = {
+	{ "exact euler", false, false, false, false, false },
+	{ "fast euler", true, false, false, false, false },
+	{ "filters", false, true, false, false, false },
+	{ "calibration", false, false, true, false, false },
+	{ "incremental", false, false, false, true, false },
+	{ "fusion", false, false, false, false, true },
+};
+const unsigned benchmarkSettingsCount = sizeof(benchmarkSettings) / sizeof(benchmarkSettings[0]);
+
+// BenchmarkArmband is the state DataCollector keeps for one armband: what the Hub's thread knows of it, and its
+// recognizer, predictor and published text. It also follows the text the recognizer enters, and compares it with the
+// text expected, if there is one.
+template<typename Classifier>
+struct BenchmarkArmband {
+	typedef BasicRecognizer<Classifier> PolicyRecognizer;
+
+	BenchmarkArmband()
+		: onArm(false), pose(poseRest), expected(0), expectedLength(0), entered(0), wrong(0)
+	{
+		orientation.roll_w = orientation.pitch_w = orientation.yaw_w = 0;
+		recognizer.verbose = false;
+	}
+
+	void configure(const BenchmarkSettings& settings)
+	{
+		recognizer.calibrating = settings.calibrating;
+		recognizer.incremental = settings.incremental;
+		recognizer.fusion = settings.fusion;
+	}
+
+	void enter(char letter)
+	{
+		if (expected && (entered >= expectedLength || expected[entered] != letter)) {
+			++wrong;
+		}
+		++entered;
+	}
+
+	bool onArm;
+	uint16_t pose;
+	ScaledOrientation orientation;
+	OrientationFilter filter;
+
+	PolicyRecognizer recognizer;
+	WordPredictor predictor;
+	TextPublisher<PolicyRecognizer::wordCapacity> text;
+
+	// The text the stream spells, or null if it isn't known. The count of characters entered includes the space
+	// entered by the first fist, which sets the first home position.
+	const char* expected;
+	size_t expectedLength;
+	size_t entered, wrong;
+};
+
+// handle() does with an event what DataCollector does with it: its callbacks convert and filter the orientation and
+// leave out the gyroscope unless fusion is on and repeated poses; recognize() runs the sample through recognizeSample()
+// and publishText() publishes the word.
+template<typename Classifier>
+void handle(BenchmarkArmband<Classifier>& armband, const BenchmarkEvent& event, const BenchmarkSettings& settings,
+	const FilterSettings& filtering)
+{
+	RecognitionSample::Kind kind = RecognitionSample::sampleOrientation;
+	switch (event.kind) {
+	case BenchmarkEvent::eventOrientation:
+		armband.orientation = armband.filter.filter(scaleOrientation(event.x, event.y, event.z, event.w,
+			settings.fastEuler), event.timestamp, filtering);
+		break;
+	case BenchmarkEvent::eventGyroscope:
+		if (!settings.fusion || !armband.onArm) {
+			return;
+		}
+		kind = RecognitionSample::sampleGyroscope;
+		break;
+	case BenchmarkEvent::eventPose:
+		if (event.pose == armband.pose) {
+			return;
+		}
+		armband.pose = event.pose;
+		kind = RecognitionSample::samplePose;
+		break;
+	case BenchmarkEvent::eventArmSync:
+		armband.onArm = true;
+		return;
+	case BenchmarkEvent::eventArmUnsync:
+		armband.onArm = false;
+		return;
+	}
+
+	RecognitionSample sample = RecognitionSample();
+	sample.kind = static_cast<uint8_t>(kind);
+	sample.armband = event.armband;
+	sample.onArm = armband.onArm;
+	sample.pose = armband.pose;
+	sample.timestamp = event.timestamp;
+	sample.roll_w = armband.orientation.roll_w;
+	sample.pitch_w = armband.orientation.pitch_w;
+	sample.yaw_w = armband.orientation.yaw_w;
+	sample.rates[0] = event.x;
+	sample.rates[1] = event.y;
+	sample.rates[2] = event.z;
+
+	typename BenchmarkArmband<Classifier>::PolicyRecognizer& recognizer = armband.recognizer;
+	RecognitionOutcome outcome = recognizeSample(recognizer, armband.predictor, sample);
+	armband.text.publish(recognizer.word);
+	for (unsigned i = outcome.appendedFrom; i < recognizer.word.size(); ++i) {
+		armband.enter(recognizer.word.c_str()[i]);
+	}
+	// The word is emptied whenever it fills up, so long streams keep decoding.
+	if (recognizer.word.size() == recognizer.wordCapacity) {
+		recognizer.word.clear();
+	}
+}
+
+// SyntheticStream builds the events of someone entering letters from the table: a fist at home, which sets the home
+// position and enters a space, then for each letter every stroke as a rotation its way about its axis and back, each
+// followed by a pause at home long enough for the cooldown to end, and a fist. Every orientation sample comes with
+// the gyroscope's reading of the rotation. With incremental decoding the strokes stop, and no fist follows, once
+// they can only spell the letter.
+class SyntheticStream {
+public:
+	static const uint64_t samplePeriod = 20000;
+
+	explicit SyntheticStream(bool incremental)
+		: incremental(incremental), timestamp(1000000)
+	{
+		BenchmarkEvent sync = event(BenchmarkEvent::eventArmSync);
+		events.push_back(sync);
+		fist();
+		text += ' ';
+	}
+
+	void letter(const LetterEntry& entry)
+	{
+		unsigned prefix = 0;
+		for (int shift = strokeBits * (maxGestureStrokes - 1); shift >= 0; shift -= strokeBits) {
+			Stroke next = static_cast<Stroke>((entry.code >> shift) & ((1u << strokeBits) - 1));
+			if (next == strokeNone) {
+				continue;
+			}
+			stroke(next);
+			prefix = appendStroke(prefix, next);
+			if (incremental && AlphabetIndex::builtIn().completionFor(prefix).action != actionNone) {
+				text += entry.letter;
+				return;
+			}
+		}
+		fist();
+		text += entry.letter;
+	}
+
+	std::vector<BenchmarkEvent> events;
+
+	// The text the events spell.
+	std::string text;
+
+private:
+	BenchmarkEvent event(BenchmarkEvent::Kind kind)
+	{
+		BenchmarkEvent result = BenchmarkEvent();
+		result.kind = static_cast<uint8_t>(kind);
+		result.timestamp = timestamp;
+		result.w = 1;
+		return result;
+	}
+
+	// orientation() adds the sample at `angle` radians about an axis, and the gyroscope reading of the turn from the
+	// previous sample.
+	void orientation(Stroke axis, float angle, float previous)
+	{
+		timestamp += samplePeriod;
+		BenchmarkEvent sample = event(BenchmarkEvent::eventOrientation);
+		float s = std::sin(angle / 2);
+		sample.x = axis == strokeRoll ? s : 0;
+		sample.y = axis == strokePitch ? s : 0;
+		sample.z = axis == strokeYaw ? s : 0;
+		sample.w = std::cos(angle / 2);
+		events.push_back(sample);
+
+		BenchmarkEvent gyroscope = event(BenchmarkEvent::eventGyroscope);
+		float rate = (angle - previous) * 180 / 3.14159265f * 1000000 / samplePeriod;
+		gyroscope.x = axis == strokeRoll ? rate : 0;
+		gyroscope.y = axis == strokePitch ? rate : 0;
+		gyroscope.z = axis == strokeYaw ? rate : 0;
+		gyroscope.w = 0;
+		events.push_back(gyroscope);
+	}
+
+	void pose(uint16_t type)
+	{
+		BenchmarkEvent change = event(BenchmarkEvent::eventPose);
+		change.pose = type;
+		events.push_back(change);
+	}
+
+	// rest() stays at home for slightly longer than the recognizer's cooldown.
+	void rest()
+	{
+		for (uint64_t waited = 0; waited <= Recognizer::cooldownDuration + 5 * samplePeriod; waited += samplePeriod) {
+			orientation(strokeNone, 0, 0);
+		}
+	}
+
+	void fist()
+	{
+		orientation(strokeNone, 0, 0);
+		pose(poseFist);
+		orientation(strokeNone, 0, 0);
+		pose(poseRest);
+		rest();
+	}
+
+	void stroke(Stroke stroke)
+	{
+		const int steps = 10;
+		Stroke axis = strokeAxis(stroke);
+		float turn = stroke & strokeNegative ? -1.0f : 1.0f;
+		for (int i = 1; i <= steps; ++i) {
+			orientation(axis, turn * i / steps, turn * (i - 1) / steps);
+		}
+		for (int i = steps - 1; i >= 0; --i) {
+			orientation(axis, turn * i / steps, turn * (i + 1) / steps);
+		}
+		rest();
+	}
+
+	bool incremental;
+	uint64_t timestamp;
+};
+
+// BenchmarkStream is a stream of events, and the text it spells on armband 0 if that is known.
+struct BenchmarkStream {
+	std::string name;
+	std::vector<BenchmarkEvent> events;
+	std::string text;
+	bool textKnown;
+};
+
+// The armbands a DataCollector tracks at a time; events of any others are left out, as it leaves them out.
+const unsigned benchmarkArmbands = 4;
+
+// loadSession() reads the events recognition cares about from a session file written by SessionRecorder.
+BenchmarkStream loadSession(const std::string& path)
+{
+	MappedFile file(path);
+	SessionHeader header;
+	if (file.size() < sizeof(header)) {
+		throw std::runtime_error(path + " is not a session file");
+	}
+	std::memcpy(&header, file.data(), sizeof(header));
+	if (std::memcmp(header.magic, sessionMagic, sizeof(header.magic)) != 0 || header.version != sessionVersion
+		|| header.recordSize != sizeof(SessionRecord)) {
+		throw std::runtime_error(path + " is not a session file this version can read");
+	}
+
+	BenchmarkStream stream;
+	stream.name = path;
+	stream.textKnown = false;
+	size_t count = (file.size() - sizeof(header)) / sizeof(SessionRecord);
+	for (size_t i = 0; i < count; ++i) {
+		SessionRecord record;
+		std::memcpy(&record, file.data() + sizeof(header) + i * sizeof(record), sizeof(record));
+		if (record.armband >= benchmarkArmbands) {
+			continue;
+		}
+
+		BenchmarkEvent event = BenchmarkEvent();
+		event.armband = record.armband;
+		event.timestamp = record.timestamp;
+		switch (record.type) {
+		case recordOrientation:
+			event.kind = BenchmarkEvent::eventOrientation;
+			event.x = record.values[0];
+			event.y = record.values[1];
+			event.z = record.values[2];
+			event.w = record.values[3];
+			break;
+		case recordGyroscope:
+			event.kind = BenchmarkEvent::eventGyroscope;
+			event.x = record.values[0];
+			event.y = record.values[1];
+			event.z = record.values[2];
+			break;
+		case recordPose:
+			event.kind = BenchmarkEvent::eventPose;
+			event.pose = record.code;
+			break;
+		case recordArmSync:
+			event.kind = BenchmarkEvent::eventArmSync;
+			break;
+		case recordArmUnsync:
+			event.kind = BenchmarkEvent::eventArmUnsync;
+			break;
+		default:
+			continue;
+		}
+		stream.events.push_back(event);
+	}
+	return stream;
+}
+
+// run() times every event of a stream through fresh armbands using one stroke classifier and one set of options,
+// and prints the results. It returns false if the stream's text is known and wasn't what was decoded.
+template<typename Classifier>
+bool run(const BenchmarkStream& stream, const char* classifier, const BenchmarkSettings& settings)
+{
+	typedef std::chrono::steady_clock Clock;
+
+	FilterSettings filtering;
+	if (settings.filtered) {
+		filtering.stages[0] = filterMedian;
+		filtering.stages[1] = filterOneEuro;
+		filtering.stageCount = 2;
+	}
+
+	// Everything the measured loop needs is allocated up front, so that the allocation count is the recognizer's own.
+	BenchmarkArmband<Classifier> armbands[benchmarkArmbands];
+	for (unsigned i = 0; i < benchmarkArmbands; ++i) {
+		armbands[i].configure(settings);
+	}
+	if (stream.textKnown) {
+		armbands[0].expected = stream.text.c_str();
+		armbands[0].expectedLength = stream.text.size();
+	}
+	const std::vector<BenchmarkEvent>& events = stream.events;
+	std::vector<uint32_t> latencies(events.size());
+
+	unsigned long long allocationsBefore = allocationCount;
+	Clock::time_point start = Clock::now();
+	for (size_t i = 0; i < events.size(); ++i) {
+		Clock::time_point before = Clock::now();
+		handle(armbands[events[i].armband], events[i], settings, filtering);
+		Clock::time_point after = Clock::now();
+		latencies[i] = static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(after - before).count());
+	}
+	std::chrono::duration<double> elapsed = Clock::now() - start;
+	unsigned long long allocations = allocationCount - allocationsBefore;
+
+	// The space each armband's first fist entered isn't a letter.
+	size_t letters = 0;
+	for (unsigned i = 0; i < benchmarkArmbands; ++i) {
+		letters += armbands[i].entered > 0 ? armbands[i].entered - 1 : 0;
+	}
+
+	std::sort(latencies.begin(), latencies.end());
+	std::cout << stream.name << " (" << classifier << ", " << settings.name << ")\n"
+		<< "  events:          " << events.size() << '\n'
+		<< "  letters:         " << letters << '\n';
+	bool decoded = true;
+	if (stream.textKnown) {
+		const BenchmarkArmband<Classifier>& armband = armbands[0];
+		decoded = armband.wrong == 0 && armband.entered == armband.expectedLength;
+		std::cout << "  text:            ";
+		if (decoded) {
+			std::cout << "as typed\n";
+		}
+		else {
+			std::cout << "WRONG: " << armband.entered << " characters entered, " << armband.wrong
+				<< " of them wrong, for " << armband.expectedLength << " typed\n";
+		}
+	}
+	std::cout << std::fixed << std::setprecision(0)
+		<< "  events/sec:      " << (elapsed.count() > 0 ? events.size() / elapsed.count() : 0) << '\n';
+	if (!latencies.empty()) {
+		const double percentiles[] = { 50, 90, 99, 99.9, 100 };
+		std::cout << "  latency (ns):   ";
+		for (unsigned i = 0; i < sizeof(percentiles) / sizeof(percentiles[0]); ++i) {
+			size_t index = std::min(latencies.size() - 1, static_cast<size_t>(percentiles[i] / 100 * latencies.size()));
+			std::cout << " p" << std::setprecision(percentiles[i] == 99.9 ? 1 : 0) << percentiles[i] << '='
+				<< latencies[index];
+		}
+		std::cout << '\n';
+	}
+	std::cout << std::setprecision(2)
+		<< "  allocations:     " << allocations << " (" << (letters ? double(allocations) / letters : 0.0)
+		<< " per letter)\n";
+	return decoded;
+}
+
+// runAll() runs a stream with each stroke classifier under each set of options. Incremental decoding needs its own
+// synthetic stream, since it takes fewer strokes and fists, so `incremental` says which settings this stream is for.
+// It returns false if any run decoded the wrong text.
+bool runAll(const BenchmarkStream& stream, bool incremental)
+{
+	bool decoded = true;
+	for (unsigned i = 0; i < benchmarkSettingsCount; ++i) {
+		const BenchmarkSettings& settings = benchmarkSettings[i];
+		if (settings.incremental != incremental) {
+			continue;
+		}
+		decoded = run<AxisPeakClassifier>(stream, "axis peak", settings) && decoded;
+		decoded = run<PathLengthClassifier>(stream, "path length", settings) && decoded;
+		decoded = run<DtwClassifier>(stream, "dtw", settings) && decoded;
+	}
+	return decoded;
+}
+
+// synthesize() builds the synthetic stream of `letters` letters, going round the table.
+BenchmarkStream synthesize(unsigned letters, bool incremental)
+{
+	SyntheticStream synthetic(incremental);
+	for (unsigned i = 0; i < letters; ++i) {
+		synthetic.letter(letterEntries[i % letterEntryCount]);
+	}
+	BenchmarkStream stream;
+	stream.name = incremental ? "synthetic, incremental" : "synthetic";
+	stream.events.swap(synthetic.events);
+	stream.text = synthetic.text;
+	stream.textKnown = true;
+	return stream;
+}
+
+int main(int argc, char** argv)
+{
+	try {
+		// --session <file> benchmarks a recorded session and may be repeated. Without it a synthetic stream of
+		// --letters <n> letters (1000 by default) is used. The exit status is 1 if a synthetic stream didn't decode to
+		// the letters it spells.
+		std::vector<std::string> sessions;
+		unsigned letters = 1000;
+		for (int i = 1; i < argc; ++i) {
+			std::string option = argv[i];
+			if (option == "--session" && i + 1 < argc) {
+				sessions.push_back(argv[++i]);
+			}
+			else if (option == "--letters" && i + 1 < argc) {
+				letters = static_cast<unsigned>(std::atoi(argv[++i]));
+			}
+			else {
+				throw std::runtime_error("Unknown option " + option);
+			}
+		}
+
+		bool decoded = true;
+		if (sessions.empty()) {
+			decoded = runAll(synthesize(letters, false), false) && decoded;
+			decoded = runAll(synthesize(letters, true), true) && decoded;
+		}
+		for (size_t i = 0; i < sessions.size(); ++i) {
+			BenchmarkStream stream = loadSession(sessions[i]);
+			runAll(stream, false);
+			runAll(stream, true);
+		}
+		if (!decoded) {
+			std::cerr << "Error: some runs didn't decode the letters typed" << std::endl;
+			return 1;
+		}
+	}
+	catch (const std::exception& e) {
+		std::cerr << "Error: " << e.what() << std::endl;
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,274 @@
+// Online calibration of the recognizer's home tolerance and axis weights to the person wearing the armband.
+#pragma once
+
+#include <cmath>
+#include <fstream>
+#include <limits>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <stdint.h>
+#include <string>
+#include <utility>
+
+#include "letter-table.hpp"
+
+// RunningStats keeps the mean and variance of a stream of values with Welford's method, which costs O(1) per value
+// and doesn't lose precision the way summing squares does. Once `horizon` values have been seen, older values are
+// forgotten exponentially, so the statistics keep following someone whose movements change over time.
+class RunningStats {
+public:
+	explicit RunningStats(uint64_t horizon = std::numeric_limits<uint64_t>::max())
+		: horizon(horizon), n(0), runningMean(0), m2(0)
+	{
+	}
+
+	void push(double value)
+	{
+		if (n < horizon) {
+			++n;
+		}
+		else {
+			m2 -= m2 / n;
+		}
+		double delta = value - runningMean;
+		runningMean += delta / n;
+		m2 += delta * (value - runningMean);
+	}
+
+	uint64_t count() const
+	{
+		return n;
+	}
+
+	double mean() const
+	{
+		return runningMean;
+	}
+
+	double variance() const
+	{
+		return n > 1 ? m2 / (n - 1) : 0;
+	}
+
+	// sumOfSquares() and restore() save and load the statistics, see CalibrationStore.
+	double sumOfSquares() const
+	{
+		return m2;
+	}
+
+	void restore(uint64_t count, double mean, double sumOfSquares)
+	{
+		n = count < horizon ? count : horizon;
+		runningMean = mean;
+		m2 = sumOfSquares;
+	}
+
+private:
+	uint64_t horizon;
+	uint64_t n;
+	double runningMean, m2;
+};
+
+// StrokeCalibration learns how one person moves on one arm, from two kinds of observations by the recognizer:
+//  - observeHome() with the offset from home of every sample while the arm rests at home, which measures how much
+//    the arm drifts and shakes when it isn't making a stroke,
+//  - observeStroke() with the peak offset on each axis of every classified stroke, which measures how far strokes
+//    about each axis usually go.
+// From these it derives, per axis (roll, pitch, yaw):
+//  - tolerance(), how far from home still counts as home: three times the RMS resting offset, but no more than half
+//    a usual stroke about that axis.
+//  - gain(), the weight the classifier gives offsets on that axis, so that an axis someone makes smaller strokes
+//    about isn't outvoted by the spill-over from wider strokes about the others.
+// Until enough has been observed the settings are the recognizer's original ones: a tolerance of 0.7 and equal
+// weights.
+class StrokeCalibration {
+public:
+	// Resting statistics follow about the last minute at home, stroke statistics about the last hundred strokes.
+	static const uint64_t noiseHorizon = 3000;
+	static const uint64_t strokeHorizon = 100;
+
+	// How many observations an axis needs before its settings are adjusted.
+	static const uint64_t minimumNoiseSamples = 100;
+	static const uint64_t minimumStrokes = 5;
+
+	StrokeCalibration()
+	{
+		for (unsigned axis = 0; axis < 3; ++axis) {
+			noise[axis] = RunningStats(noiseHorizon);
+			amplitude[axis] = RunningStats(strokeHorizon);
+		}
+		update();
+	}
+
+	void observeHome(float roll, float pitch, float yaw)
+	{
+		noise[0].push(roll);
+		noise[1].push(pitch);
+		noise[2].push(yaw);
+		for (unsigned axis = 0; axis < 3; ++axis) {
+			tolerances[axis] = toleranceFor(axis);
+		}
+	}
+
+	// observeStroke() takes the stroke's axis and the absolute peak offsets on roll, pitch and yaw.
+	void observeStroke(Stroke stroke, const float peaks[3])
+	{
+		if (stroke == strokeNone) {
+			return;
+		}
+		unsigned axis = strokeAxis(stroke) - strokeRoll;
+		amplitude[axis].push(peaks[axis]);
+		update();
+	}
+
+	float tolerance(unsigned axis) const
+	{
+		return tolerances[axis];
+	}
+
+	float gain(unsigned axis) const
+	{
+		return gains[axis];
+	}
+
+	// strokeCount() is how many strokes the calibration has learned from, up to the horizon.
+	uint64_t strokeCount() const
+	{
+		return amplitude[0].count() + amplitude[1].count() + amplitude[2].count();
+	}
+
+	// update() recomputes the settings, for when the statistics have been restored from a file.
+	void update()
+	{
+		double total = 0;
+		unsigned calibrated = 0;
+		for (unsigned axis = 0; axis < 3; ++axis) {
+			tolerances[axis] = toleranceFor(axis);
+			if (amplitude[axis].count() >= minimumStrokes && amplitude[axis].mean() > 0) {
+				total += amplitude[axis].mean();
+				++calibrated;
+			}
+		}
+		for (unsigned axis = 0; axis < 3; ++axis) {
+			gains[axis] = 1;
+			// Weights only mean something relative to another axis.
+			if (calibrated >= 2 && amplitude[axis].count() >= minimumStrokes && amplitude[axis].mean() > 0) {
+				double weight = total / calibrated / amplitude[axis].mean();
+				gains[axis] = static_cast<float>(weight < 0.5 ? 0.5 : weight > 2 ? 2 : weight);
+			}
+		}
+	}
+
+	RunningStats noise[3];
+	RunningStats amplitude[3];
+
+private:
+	float toleranceFor(unsigned axis) const
+	{
+		const double defaultTolerance = 0.7, minimumTolerance = 0.3, maximumTolerance = 1.5;
+		if (noise[axis].count() < minimumNoiseSamples) {
+			return static_cast<float>(defaultTolerance);
+		}
+		double rms = std::sqrt(noise[axis].mean() * noise[axis].mean() + noise[axis].variance());
+		double tolerance = 3 * rms;
+		if (tolerance > maximumTolerance) {
+			tolerance = maximumTolerance;
+		}
+		// A stroke has to be able to leave home, so home can't reach halfway to where strokes usually peak.
+		if (amplitude[axis].count() >= minimumStrokes && tolerance > amplitude[axis].mean() / 2) {
+			tolerance = amplitude[axis].mean() / 2;
+		}
+		if (tolerance < minimumTolerance) {
+			tolerance = minimumTolerance;
+		}
+		return static_cast<float>(tolerance);
+	}
+
+	float tolerances[3];
+	float gains[3];
+};
+
+// CalibrationStore keeps a StrokeCalibration for every user and arm, in a text file so that the next session starts
+// with what the last one learned. Each line is a user name, an arm and the count, mean and sum of squares of the six
+// statistics. The statistics themselves are stored rather than the settings derived from them, so learning carries
+// on where it left off.
+class CalibrationStore {
+public:
+	// The file doesn't have to exist yet; the constructor throws std::runtime_error if it exists but can't be read.
+	explicit CalibrationStore(const std::string& path)
+		: path(path)
+	{
+		std::ifstream input(path.c_str());
+		if (!input) {
+			return;
+		}
+		std::string line;
+		while (std::getline(input, line)) {
+			if (line.empty() || line[0] == '#') {
+				continue;
+			}
+			std::istringstream fields(line);
+			std::string user, arm;
+			StrokeCalibration calibration;
+			fields >> user >> arm;
+			for (unsigned i = 0; i < 6; ++i) {
+				uint64_t count;
+				double mean, sumOfSquares;
+				fields >> count >> mean >> sumOfSquares;
+				statistic(calibration, i).restore(count, mean, sumOfSquares);
+			}
+			if (!fields) {
+				throw std::runtime_error(path + " is not a calibration file");
+			}
+			calibration.update();
+			profiles[std::make_pair(user, arm)] = calibration;
+		}
+	}
+
+	// find() returns the calibration for a user on an arm, or a fresh one if there is none yet.
+	StrokeCalibration find(const std::string& user, const std::string& arm) const
+	{
+		std::map<Key, StrokeCalibration>::const_iterator profile = profiles.find(std::make_pair(user, arm));
+		return profile != profiles.end() ? profile->second : StrokeCalibration();
+	}
+
+	void update(const std::string& user, const std::string& arm, const StrokeCalibration& calibration)
+	{
+		profiles[std::make_pair(user, arm)] = calibration;
+	}
+
+	// save() writes every profile back to the file. It returns false if the file couldn't be written.
+	bool save() const
+	{
+		std::ofstream output(path.c_str(), std::ios::trunc);
+		output << "# user arm, then count mean sum-of-squares for resting roll, pitch and yaw and stroke roll, pitch "
+			"and yaw\n";
+		output.precision(std::numeric_limits<double>::digits10 + 2);
+		for (std::map<Key, StrokeCalibration>::const_iterator i = profiles.begin(); i != profiles.end(); ++i) {
+			output << i->first.first << ' ' << i->first.second;
+			for (unsigned j = 0; j < 6; ++j) {
+				const RunningStats& stats = statistic(i->second, j);
+				output << ' ' << stats.count() << ' ' << stats.mean() << ' ' << stats.sumOfSquares();
+			}
+			output << '\n';
+		}
+		return static_cast<bool>(output.flush());
+	}
+
+private:
+	typedef std::pair<std::string, std::string> Key;
+
+	static RunningStats& statistic(StrokeCalibration& calibration, unsigned index)
+	{
+		return index < 3 ? calibration.noise[index] : calibration.amplitude[index - 3];
+	}
+
+	static const RunningStats& statistic(const StrokeCalibration& calibration, unsigned index)
+	{
+		return index < 3 ? calibration.noise[index] : calibration.amplitude[index - 3];
+	}
+
+	std::string path;
+	std::map<Key, StrokeCalibration> profiles;
+};
@@ -0,0 +1,99 @@
+// A status line for the console that is rebuilt every frame but only written out when it changes.
+#pragma once
+
+#include <atomic>
+#include <cstring>
+#include <ostream>
+
+// ConsoleRenderer collects one frame of output in a fixed buffer and writes it with a single call. Characters beyond
+// the capacity are dropped, so building a frame never allocates.
+class ConsoleRenderer {
+public:
+	static const unsigned capacity = 512;
+
+	ConsoleRenderer()
+		: length(0), shownLength(0), stale(true)
+	{
+	}
+
+	// begin() starts a new frame.
+	void begin()
+	{
+		length = 0;
+	}
+
+	void put(char c)
+	{
+		if (length < capacity) {
+			frame[length++] = c;
+		}
+	}
+
+	void put(const char* text, unsigned count)
+	{
+		if (count > capacity - length) {
+			count = capacity - length;
+		}
+		std::memcpy(frame + length, text, count);
+		length += count;
+	}
+
+	void put(const char* text)
+	{
+		put(text, static_cast<unsigned>(std::strlen(text)));
+	}
+
+	// putNumber() appends a number right-aligned in a field of `width` characters.
+	void putNumber(unsigned value, unsigned width)
+	{
+		char digits[10];
+		unsigned count = 0;
+		do {
+			digits[count++] = static_cast<char>('0' + value % 10);
+			value /= 10;
+		} while (value && count < sizeof(digits));
+		if (width > count) {
+			fill(' ', width - count);
+		}
+		while (count) {
+			put(digits[--count]);
+		}
+	}
+
+	// fill() appends `count` copies of a character.
+	void fill(char c, unsigned count)
+	{
+		if (count > capacity - length) {
+			count = capacity - length;
+		}
+		std::memset(frame + length, c, count);
+		length += count;
+	}
+
+	// present() writes the frame and flushes, unless it is the same as the frame written last and nothing else has
+	// been printed since. It returns true if the frame was written.
+	bool present(std::ostream& out)
+	{
+		bool overwritten = stale.exchange(false);
+		if (!overwritten && length == shownLength && std::memcmp(frame, shown, length) == 0) {
+			return false;
+		}
+		out.write(frame, length).flush();
+		std::memcpy(shown, frame, length);
+		shownLength = length;
+		return true;
+	}
+
+	// invalidate() tells the renderer that something else was printed over its last frame, so the next frame must be
+	// written even if it hasn't changed. It may be called from any thread.
+	void invalidate()
+	{
+		stale = true;
+	}
+
+private:
+	char frame[capacity];
+	char shown[capacity];
+	unsigned length, shownLength;
+	std::atomic<bool> stale;
+};
@@ -0,0 +1,197 @@
+// Conversion of recorded sessions to labelled columnar datasets (see session-dataset.hpp), and batch evaluation of
+// recognizer policies over a whole corpus of them on every core. Like the benchmark it needs neither the Myo SDK nor
+// a Myo, so it builds anywhere (see Makefile) as well as from the Visual Studio solution.
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "dtw-classifier.hpp"
+#include "session-dataset.hpp"
+
+// The recognizer policies that can be evaluated, by their stroke classifier.
+enum Policy {
+	policyAxisPeak,
+	policyPathLength,
+	policyDtw,
+	policyCount
+};
+
+const char* const policyNames[policyCount] = { "axis-peak", "path-length", "dtw" };
+
+DatasetScore evaluate(Policy policy, const SessionDataset& dataset, const DecoderSettings& settings)
+{
+	switch (policy) {
+	case policyPathLength:
+		return evaluateDataset<PathLengthClassifier>(dataset, settings);
+	case policyDtw:
+		return evaluateDataset<DtwClassifier>(dataset, settings);
+	default:
+		return evaluateDataset<AxisPeakClassifier>(dataset, settings);
+	}
+}
+
+// FileResult is what evaluating one dataset with every chosen policy came to.
+struct FileResult {
+	DatasetScore scores[policyCount];
+	std::string error;
+};
+
+// evaluateCorpus() evaluates every dataset with every chosen policy, each dataset on whichever of `threads` workers
+// gets to it first. A dataset that can't be read is reported rather than stopping the others.
+std::vector<FileResult> evaluateCorpus(const std::vector<std::string>& paths, const std::vector<Policy>& policies,
+	const DecoderSettings& settings, unsigned threads)
+{
+	std::vector<FileResult> results(paths.size());
+	std::atomic<size_t> next(0);
+	std::vector<std::thread> workers;
+	for (unsigned i = 0; i < threads; ++i) {
+		workers.push_back(std::thread([&]() {
+			for (size_t file = next++; file < paths.size(); file = next++) {
+				try {
+					SessionDataset dataset = readDataset(paths[file]);
+					for (size_t policy = 0; policy < policies.size(); ++policy) {
+						results[file].scores[policies[policy]] = evaluate(policies[policy], dataset, settings);
+					}
+				}
+				catch (const std::exception& e) {
+					results[file].error = e.what();
+				}
+			}
+		}));
+	}
+	for (size_t i = 0; i < workers.size(); ++i) {
+		workers[i].join();
+	}
+	return results;
+}
+
+void printScore(const std::string& name, const char* policy, const DatasetScore& score)
+{
+	std::cout << name << " (" << policy << ")\n"
+		<< "  labels:      " << score.labels << '\n'
+		<< "  correct:     " << score.correct << '\n'
+		<< "  substituted: " << score.substituted << '\n'
+		<< "  missed:      " << score.missed << '\n'
+		<< "  inserted:    " << score.inserted << '\n'
+		<< std::fixed << std::setprecision(2)
+		<< "  accuracy:    " << 100 * score.accuracy() << "%\n";
+}
+
+void usage()
+{
+	std::cerr << "Usage: hello-myo-dataset export <session> <dataset>\n"
+		"       hello-myo-dataset evaluate [--policy axis-peak|path-length|dtw|all] [--fast-euler] [--fusion]\n"
+		"                                  [--threads <n>] [--quiet] <dataset>...\n";
+}
+
+int main(int argc, char** argv)
+{
+	try {
+		std::string command = argc > 1 ? argv[1] : "";
+		if (command == "export" && argc == 4) {
+			// export labels a session with the letters the default recognizer decodes from it and writes it out.
+			SessionDataset dataset = labelSession(argv[2]);
+			writeDataset(dataset, argv[3]);
+			std::cout << argv[3] << ": " << dataset.orientation.sequence.size() << " orientation, "
+				<< dataset.gyroscope.sequence.size() << " gyroscope, " << dataset.pose.sequence.size() << " pose, "
+				<< dataset.emg.sequence.size() << " EMG samples, " << dataset.letters.end.size() << " letters\n";
+			return 0;
+		}
+		if (command != "evaluate") {
+			usage();
+			return 1;
+		}
+
+		// evaluate decodes every dataset with the chosen policies (all of them by default), and prints the score of
+		// each, unless --quiet, and the totals.
+		std::vector<Policy> policies;
+		DecoderSettings settings;
+		unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+		bool quiet = false;
+		std::vector<std::string> paths;
+		for (int i = 2; i < argc; ++i) {
+			std::string option = argv[i];
+			if (option == "--policy" && i + 1 < argc) {
+				std::string name = argv[++i];
+				for (unsigned policy = 0; policy < policyCount; ++policy) {
+					if (name == policyNames[policy] || name == "all") {
+						policies.push_back(static_cast<Policy>(policy));
+					}
+				}
+				if (policies.empty()) {
+					throw std::runtime_error("Unknown policy " + name);
+				}
+			}
+			else if (option == "--fast-euler") {
+				settings.fastEuler = true;
+			}
+			else if (option == "--fusion") {
+				settings.fusion = true;
+			}
+			else if (option == "--threads" && i + 1 < argc) {
+				int count = std::atoi(argv[++i]);
+				if (count < 1) {
+					throw std::runtime_error("--threads must be at least 1");
+				}
+				threads = static_cast<unsigned>(count);
+			}
+			else if (option == "--quiet") {
+				quiet = true;
+			}
+			else if (option.compare(0, 2, "--") == 0) {
+				throw std::runtime_error("Unknown option " + option);
+			}
+			else {
+				paths.push_back(option);
+			}
+		}
+		if (policies.empty()) {
+			for (unsigned policy = 0; policy < policyCount; ++policy) {
+				policies.push_back(static_cast<Policy>(policy));
+			}
+		}
+		std::sort(policies.begin(), policies.end());
+		policies.erase(std::unique(policies.begin(), policies.end()), policies.end());
+
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		std::vector<FileResult> results = evaluateCorpus(paths, policies, settings, threads);
+		std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+		DatasetScore totals[policyCount];
+		unsigned failed = 0;
+		for (size_t file = 0; file < results.size(); ++file) {
+			if (!results[file].error.empty()) {
+				std::cerr << "Error: " << results[file].error << '\n';
+				++failed;
+				continue;
+			}
+			for (size_t policy = 0; policy < policies.size(); ++policy) {
+				const DatasetScore& score = results[file].scores[policies[policy]];
+				totals[policies[policy]] += score;
+				if (!quiet) {
+					printScore(paths[file], policyNames[policies[policy]], score);
+				}
+			}
+		}
+		std::ostringstream corpus;
+		corpus << "corpus of " << results.size() - failed << " datasets";
+		for (size_t policy = 0; policy < policies.size(); ++policy) {
+			printScore(corpus.str(), policyNames[policies[policy]], totals[policies[policy]]);
+		}
+		std::cout << std::setprecision(2) << "evaluated in " << elapsed.count() << " s on " << threads
+			<< " threads\n";
+		return failed ? 1 : 0;
+	}
+	catch (const std::exception& e) {
+		std::cerr << "Error: " << e.what() << std::endl;
+		return 1;
+	}
+}
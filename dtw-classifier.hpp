@@ -0,0 +1,405 @@
+// Stroke classification by matching the whole trajectory of a stroke against templates with dynamic time warping.
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <limits>
+#include <map>
+#include <ostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "letter-table.hpp"
+#include "stroke-classifiers.hpp"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define DTW_CLASSIFIER_SSE2 1
+#include <emmintrin.h>
+#endif
+
+// Every trajectory is resampled to dtwLength points before matching. The warping path may stray at most dtwBand
+// points from the diagonal (the Sakoe-Chiba band).
+const unsigned dtwLength = 32;
+const unsigned dtwBand = 4;
+
+// DtwTrajectory holds a stroke's offset from home on each axis (roll, pitch, yaw), resampled to dtwLength points and
+// scaled so that its largest offset is 1. Each axis is contiguous so the distance loops vectorize.
+struct DtwTrajectory {
+	float axis[3][dtwLength];
+};
+
+// dtwCost() fills cost[k] with the squared distance between point i of the query and point first + k of the
+// template, for the `count` template points starting at `first`.
+inline void dtwCost(const DtwTrajectory& query, unsigned i, const DtwTrajectory& reference, unsigned first,
+	unsigned count, float* cost)
+{
+	unsigned k = 0;
+#ifdef DTW_CLASSIFIER_SSE2
+	__m128 q0 = _mm_set1_ps(query.axis[0][i]), q1 = _mm_set1_ps(query.axis[1][i]), q2 = _mm_set1_ps(query.axis[2][i]);
+	for (; k + 4 <= count; k += 4) {
+		__m128 d0 = _mm_sub_ps(q0, _mm_loadu_ps(reference.axis[0] + first + k));
+		__m128 d1 = _mm_sub_ps(q1, _mm_loadu_ps(reference.axis[1] + first + k));
+		__m128 d2 = _mm_sub_ps(q2, _mm_loadu_ps(reference.axis[2] + first + k));
+		_mm_storeu_ps(cost + k, _mm_add_ps(_mm_add_ps(_mm_mul_ps(d0, d0), _mm_mul_ps(d1, d1)), _mm_mul_ps(d2, d2)));
+	}
+#endif
+	for (; k < count; ++k) {
+		float d0 = query.axis[0][i] - reference.axis[0][first + k];
+		float d1 = query.axis[1][i] - reference.axis[1][first + k];
+		float d2 = query.axis[2][i] - reference.axis[2][first + k];
+		cost[k] = d0 * d0 + d1 * d1 + d2 * d2;
+	}
+}
+
+// dtwDistance() returns the banded DTW distance between two trajectories, or infinity as soon as every cell of a row
+// exceeds `abandonAbove`, since the full distance can then only be larger.
+inline float dtwDistance(const DtwTrajectory& query, const DtwTrajectory& reference, float abandonAbove)
+{
+	const float infinity = std::numeric_limits<float>::infinity();
+	// Two rows of the cumulative cost matrix, indexed by template point and padded by one on the left.
+	float previous[dtwLength + 1], current[dtwLength + 1];
+	float cost[2 * dtwBand + 1];
+	std::fill(previous, previous + dtwLength + 1, infinity);
+	previous[0] = 0;
+
+	for (unsigned i = 0; i < dtwLength; ++i) {
+		unsigned first = i > dtwBand ? i - dtwBand : 0;
+		unsigned last = std::min(dtwLength - 1, i + dtwBand);
+		dtwCost(query, i, reference, first, last - first + 1, cost);
+
+		std::fill(current, current + dtwLength + 1, infinity);
+		float rowMinimum = infinity;
+		for (unsigned j = first; j <= last; ++j) {
+			float best = std::min(previous[j], std::min(previous[j + 1], current[j]));
+			current[j + 1] = cost[j - first] + best;
+			rowMinimum = std::min(rowMinimum, current[j + 1]);
+		}
+		if (rowMinimum > abandonAbove) {
+			return infinity;
+		}
+		// Only the first row may start the path from the corner.
+		previous[0] = infinity;
+		std::copy(current + 1, current + dtwLength + 1, previous + 1);
+	}
+	return previous[dtwLength];
+}
+
+// DtwTemplateSet is the alphabet of stroke shapes the DtwClassifier matches against. Each template is labelled with a
+// stroke, axis and direction, and keeps the LB_Keogh envelope of its trajectory: the minimum and maximum of each axis
+// within dtwBand points. Several templates may share a stroke, for the different shapes a turn can take.
+class DtwTemplateSet {
+public:
+	struct Template {
+		DtwTrajectory trajectory;
+		DtwTrajectory lower, upper;
+		Stroke stroke;
+	};
+
+	// builtIn() is the set a DtwClassifier matches against unless it is given a user's own, see DtwTemplateLibrary.
+	static const DtwTemplateSet& builtIn()
+	{
+		static const DtwTemplateSet set = defaultTemplates();
+		return set;
+	}
+
+	// defaultTemplates() has a turn out and back in either direction about each axis.
+	static DtwTemplateSet defaultTemplates()
+	{
+		static const Stroke strokes[3] = { strokeRoll, strokePitch, strokeYaw };
+		DtwTemplateSet set;
+		for (unsigned axis = 0; axis < 3; ++axis) {
+			for (int direction = -1; direction <= 1; direction += 2) {
+				DtwTrajectory trajectory = DtwTrajectory();
+				for (unsigned i = 0; i < dtwLength; ++i) {
+					trajectory.axis[axis][i] = direction * std::sin(3.14159265f * i / (dtwLength - 1));
+				}
+				set.add(trajectory, directedStroke(strokes[axis], static_cast<float>(direction)));
+			}
+		}
+		return set;
+	}
+
+	void add(const DtwTrajectory& trajectory, Stroke stroke)
+	{
+		Template entry;
+		entry.trajectory = trajectory;
+		entry.stroke = stroke;
+		for (unsigned axis = 0; axis < 3; ++axis) {
+			for (unsigned i = 0; i < dtwLength; ++i) {
+				unsigned first = i > dtwBand ? i - dtwBand : 0;
+				unsigned last = std::min(dtwLength - 1, i + dtwBand);
+				const float* values = trajectory.axis[axis];
+				entry.lower.axis[axis][i] = *std::min_element(values + first, values + last + 1);
+				entry.upper.axis[axis][i] = *std::max_element(values + first, values + last + 1);
+			}
+		}
+		templates.push_back(entry);
+	}
+
+	// load() replaces the templates with those in a text file. Each line is a stroke followed by the 3 * dtwLength
+	// values of a DtwTrajectory, roll first; blank lines and lines starting with '#' are skipped. The stroke is named
+	// as in alphabet files: "roll-" and the like, or just "roll", "pitch" or "yaw" for the direction the trajectory
+	// goes furthest in on that axis.
+	void load(const std::string& path)
+	{
+		std::ifstream file(path.c_str());
+		if (!file) {
+			throw std::runtime_error("Unable to open template file " + path);
+		}
+		DtwTemplateSet loaded;
+		std::string line;
+		while (std::getline(file, line)) {
+			std::istringstream fields(line);
+			std::string name;
+			if (!(fields >> name) || name[0] == '#') {
+				continue;
+			}
+			Stroke stroke = name == "roll" ? strokeRoll : name == "pitch" ? strokePitch : name == "yaw" ? strokeYaw
+				: strokeNone;
+			bool directed = stroke == strokeNone;
+			for (unsigned named = strokeRoll; directed && named <= strokeYawNegative; ++named) {
+				if (name == strokeNames[named]) {
+					stroke = static_cast<Stroke>(named);
+				}
+			}
+			DtwTrajectory trajectory;
+			for (unsigned axis = 0; axis < 3; ++axis) {
+				for (unsigned i = 0; i < dtwLength; ++i) {
+					fields >> trajectory.axis[axis][i];
+				}
+			}
+			if (stroke == strokeNone || !fields) {
+				throw std::runtime_error("Malformed template in " + path + ": " + line);
+			}
+			if (!directed) {
+				const float* values = trajectory.axis[stroke - strokeRoll];
+				const float* furthest = values;
+				for (unsigned i = 1; i < dtwLength; ++i) {
+					if (std::abs(values[i]) > std::abs(*furthest)) {
+						furthest = values + i;
+					}
+				}
+				stroke = directedStroke(stroke, *furthest);
+			}
+			loaded.add(trajectory, stroke);
+		}
+		templates.swap(loaded.templates);
+	}
+
+	size_t size() const
+	{
+		return templates.size();
+	}
+
+	const Template& operator[](size_t i) const
+	{
+		return templates[i];
+	}
+
+private:
+	std::vector<Template> templates;
+};
+
+// DtwTemplateLibrary holds the template sets loaded from files, one for each user who has their own and one for
+// everyone else, the way AlphabetLibrary holds alphabets. The sets are loaded once, before recognition starts.
+class DtwTemplateLibrary {
+public:
+	// load() reads a template file for a user, or for everyone without their own if `user` is empty, and throws
+	// std::runtime_error if it can't be read.
+	void load(const std::string& user, const std::string& path)
+	{
+		DtwTemplateSet set;
+		set.load(path);
+		sets[user] = set;
+	}
+
+	bool empty() const
+	{
+		return sets.empty();
+	}
+
+	// setFor() returns the set a user's classifier matches against. It stays valid as long as the library, unless
+	// the same user's templates are loaded again.
+	const DtwTemplateSet& setFor(const std::string& user) const
+	{
+		std::map<std::string, DtwTemplateSet>::const_iterator set = sets.find(user);
+		if (set == sets.end()) {
+			set = sets.find(std::string());
+		}
+		return set != sets.end() ? set->second : DtwTemplateSet::builtIn();
+	}
+
+private:
+	std::map<std::string, DtwTemplateSet> sets;
+};
+
+// lbKeogh() is a lower bound on dtwDistance(query, entry.trajectory): how far the query lies outside the template's
+// envelope. It costs one pass over the points, so most templates can be ruled out without running DTW on them.
+inline float lbKeogh(const DtwTrajectory& query, const DtwTemplateSet::Template& entry)
+{
+	float bound = 0;
+	for (unsigned axis = 0; axis < 3; ++axis) {
+		const float* q = query.axis[axis];
+		const float* lower = entry.lower.axis[axis];
+		const float* upper = entry.upper.axis[axis];
+		unsigned i = 0;
+#ifdef DTW_CLASSIFIER_SSE2
+		__m128 sum = _mm_setzero_ps();
+		for (; i + 4 <= dtwLength; i += 4) {
+			__m128 value = _mm_loadu_ps(q + i);
+			// At most one of these is non-zero for each point.
+			__m128 above = _mm_max_ps(_mm_sub_ps(value, _mm_loadu_ps(upper + i)), _mm_setzero_ps());
+			__m128 below = _mm_max_ps(_mm_sub_ps(_mm_loadu_ps(lower + i), value), _mm_setzero_ps());
+			__m128 outside = _mm_add_ps(above, below);
+			sum = _mm_add_ps(sum, _mm_mul_ps(outside, outside));
+		}
+		float lanes[4];
+		_mm_storeu_ps(lanes, sum);
+		bound += lanes[0] + lanes[1] + lanes[2] + lanes[3];
+#endif
+		for (; i < dtwLength; ++i) {
+			float outside = q[i] > upper[i] ? q[i] - upper[i] : q[i] < lower[i] ? lower[i] - q[i] : 0;
+			bound += outside * outside;
+		}
+	}
+	return bound;
+}
+
+// DtwClassifier is a stroke classifier policy (see stroke-classifiers.hpp) that records the stroke's trajectory and
+// labels it with the stroke of the nearest of its `templates`. Unlike the peak rules it looks at the whole shape of
+// the movement, so templates can tell apart, say, a roll that overshoots from a roll followed by a pitch, or a turn
+// one way that swings back past home from a turn the other way.
+class DtwClassifier {
+public:
+	// Samples kept per stroke. Longer strokes are thinned out by dropping every other sample when the buffer fills.
+	static const unsigned maxSamples = 256;
+
+	// Strokes whose nearest template is further than this are not classified.
+	static float rejectDistance()
+	{
+		return 8.0f;
+	}
+
+	DtwClassifier()
+		: templates(&DtwTemplateSet::builtIn())
+	{
+		reset();
+	}
+
+	void reset()
+	{
+		count = 0;
+		stride = 1;
+		skipped = 0;
+		lastDistance = 0;
+	}
+
+	void observe(float roll, float pitch, float yaw)
+	{
+		if (++skipped < stride) {
+			return;
+		}
+		skipped = 0;
+		if (count == maxSamples) {
+			for (unsigned i = 0; i < maxSamples / 2; ++i) {
+				for (unsigned axis = 0; axis < 3; ++axis) {
+					samples[axis][i] = samples[axis][2 * i];
+				}
+			}
+			count = maxSamples / 2;
+			stride *= 2;
+		}
+		// Roll and yaw wrap around at 18 on the orientation scale, so take the shorter way round.
+		samples[0][count] = unwrapOffset(roll);
+		samples[1][count] = pitch;
+		samples[2][count] = unwrapOffset(yaw);
+		++count;
+	}
+
+	Stroke classify()
+	{
+		lastDistance = std::numeric_limits<float>::infinity();
+		if (count < 2) {
+			return strokeNone;
+		}
+
+		DtwTrajectory query;
+		resample(query);
+
+		// Try templates in order of their lower bound, and stop once the bound alone exceeds the best match.
+		std::pair<float, unsigned> order[maxTemplates];
+		unsigned considered = static_cast<unsigned>(std::min<size_t>(templates->size(), maxTemplates));
+		for (unsigned i = 0; i < considered; ++i) {
+			order[i] = std::make_pair(lbKeogh(query, (*templates)[i]), i);
+		}
+		std::sort(order, order + considered);
+
+		float best = rejectDistance();
+		Stroke stroke = strokeNone;
+		for (unsigned i = 0; i < considered && order[i].first < best; ++i) {
+			const DtwTemplateSet::Template& entry = (*templates)[order[i].second];
+			float distance = dtwDistance(query, entry.trajectory, best);
+			if (distance < best) {
+				best = distance;
+				stroke = entry.stroke;
+			}
+		}
+		lastDistance = best;
+		return stroke;
+	}
+
+	void describe(std::ostream& out) const
+	{
+		out << count * stride << " samples, distance " << lastDistance << '\n';
+	}
+
+	// The templates strokes are matched against. reset() keeps them.
+	const DtwTemplateSet* templates;
+
+private:
+	// Templates beyond this many are ignored, so that classify() needs no allocation.
+	static const unsigned maxTemplates = 64;
+
+	// resample() stretches the recorded samples linearly to dtwLength points and scales them to a peak of 1.
+	void resample(DtwTrajectory& query) const
+	{
+		float peak = 0;
+		for (unsigned axis = 0; axis < 3; ++axis) {
+			for (unsigned i = 0; i < count; ++i) {
+				peak = std::max(peak, std::abs(samples[axis][i]));
+			}
+		}
+		float scale = peak > 0 ? 1 / peak : 0;
+		for (unsigned i = 0; i < dtwLength; ++i) {
+			float position = float(i) * (count - 1) / (dtwLength - 1);
+			unsigned before = std::min(static_cast<unsigned>(position), count - 2);
+			float weight = position - before;
+			for (unsigned axis = 0; axis < 3; ++axis) {
+				const float* values = samples[axis];
+				query.axis[axis][i] = (values[before] + weight * (values[before + 1] - values[before])) * scale;
+			}
+		}
+	}
+
+	float samples[3][maxSamples];
+	unsigned count;
+	unsigned stride, skipped;
+	float lastDistance;
+};
+
+// useTemplates() has a classifier match against `templates`, and returns false if it doesn't use templates at all.
+template<typename Classifier>
+bool useTemplates(Classifier&, const DtwTemplateSet&)
+{
+	return false;
+}
+
+inline bool useTemplates(DtwClassifier& classifier, const DtwTemplateSet& templates)
+{
+	classifier.templates = &templates;
+	return true;
+}
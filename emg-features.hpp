@@ -0,0 +1,183 @@
+// Sliding-window features of the raw 8-channel EMG stream, for recognizing poses without the SDK's pose detector.
+#pragma once
+
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <stdint.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define EMG_FEATURES_SSE2 1
+#include <emmintrin.h>
+#endif
+
+// The Myo reports eight EMG channels, 200 times a second.
+const unsigned emgChannels = 8;
+
+// EmgFeatures are the per-channel features of one window: root mean square, mean absolute value and the number of
+// zero crossings.
+struct EmgFeatures {
+	float rms[emgChannels];
+	float mav[emgChannels];
+	unsigned zeroCrossings[emgChannels];
+};
+
+// EmgWindow keeps the last WindowSize samples in a fixed ring, along with running per-channel sums of |x|, x^2 and
+// sign changes between consecutive samples. push() updates the sums for the sample entering the window and the one
+// leaving it, so features() costs the same however long the window is. With SSE2 all eight channels are updated at
+// once; otherwise a scalar loop does the same arithmetic.
+template<unsigned WindowSize>
+class EmgWindow {
+	static_assert(WindowSize >= 2 && WindowSize <= 32767, "EMG windows must fit the 16-bit crossing counters");
+
+public:
+	EmgWindow()
+	{
+		clear();
+	}
+
+	void clear()
+	{
+		std::memset(samples, 0, sizeof(samples));
+		std::memset(sumAbs, 0, sizeof(sumAbs));
+		std::memset(sumSquares, 0, sizeof(sumSquares));
+		std::memset(crossings, 0, sizeof(crossings));
+		newest = WindowSize - 1;
+		count = 0;
+	}
+
+	// push() adds one sample of all eight channels, dropping the oldest once the window is full.
+	void push(const int8_t* emg)
+	{
+		unsigned next = newest + 1 == WindowSize ? 0 : newest + 1;
+		const int8_t* previous = samples[newest];
+		// When the window is full, `next` holds the oldest sample and the one after it is the second oldest.
+		const int8_t* oldest = samples[next];
+		const int8_t* secondOldest = samples[next + 1 == WindowSize ? 0 : next + 1];
+		bool full = count == WindowSize;
+
+#ifdef EMG_FEATURES_SSE2
+		__m128i zero = _mm_setzero_si128();
+		__m128i in = widen(emg);
+		__m128i last = widen(previous);
+		__m128i absIn = absolute(in);
+		__m128i squaresIn = _mm_mullo_epi16(in, in);
+		// A crossing is a pair of samples whose signs differ, which is when their xor is negative.
+		__m128i crossingIn = count > 0 ? _mm_cmplt_epi16(_mm_xor_si128(in, last), zero) : zero;
+
+		__m128i absOut = zero, squaresOut = zero, crossingOut = zero;
+		if (full) {
+			__m128i out = widen(oldest);
+			absOut = absolute(out);
+			squaresOut = _mm_mullo_epi16(out, out);
+			crossingOut = _mm_cmplt_epi16(_mm_xor_si128(out, widen(secondOldest)), zero);
+		}
+
+		// |x| and x^2 of an int8 fit in 16 bits, but their sums need 32.
+		__m128i* abs32 = reinterpret_cast<__m128i*>(sumAbs);
+		__m128i* squares32 = reinterpret_cast<__m128i*>(sumSquares);
+		__m128i absDelta = _mm_sub_epi16(absIn, absOut);
+		_mm_storeu_si128(abs32, _mm_add_epi32(_mm_loadu_si128(abs32), low32(absDelta)));
+		_mm_storeu_si128(abs32 + 1, _mm_add_epi32(_mm_loadu_si128(abs32 + 1), high32(absDelta)));
+		_mm_storeu_si128(squares32, _mm_add_epi32(_mm_loadu_si128(squares32),
+			_mm_sub_epi32(lowUnsigned32(squaresIn), lowUnsigned32(squaresOut))));
+		_mm_storeu_si128(squares32 + 1, _mm_add_epi32(_mm_loadu_si128(squares32 + 1),
+			_mm_sub_epi32(highUnsigned32(squaresIn), highUnsigned32(squaresOut))));
+
+		// The comparisons give -1 for a crossing, so subtracting them counts.
+		__m128i* crossings16 = reinterpret_cast<__m128i*>(crossings);
+		_mm_storeu_si128(crossings16, _mm_add_epi16(_mm_sub_epi16(_mm_loadu_si128(crossings16), crossingIn), crossingOut));
+#else
+		for (unsigned channel = 0; channel < emgChannels; ++channel) {
+			int in = emg[channel];
+			sumAbs[channel] += std::abs(in);
+			sumSquares[channel] += in * in;
+			if (count > 0 && (in ^ previous[channel]) < 0) {
+				++crossings[channel];
+			}
+			if (full) {
+				int out = oldest[channel];
+				sumAbs[channel] -= std::abs(out);
+				sumSquares[channel] -= out * out;
+				if ((out ^ secondOldest[channel]) < 0) {
+					--crossings[channel];
+				}
+			}
+		}
+#endif
+
+		std::memcpy(samples[next], emg, emgChannels);
+		newest = next;
+		if (!full) {
+			++count;
+		}
+	}
+
+	// features() returns the features of the samples currently in the window. They are all zero until a sample has
+	// been pushed.
+	EmgFeatures features() const
+	{
+		EmgFeatures result;
+		float scale = count ? 1.0f / count : 0.0f;
+		for (unsigned channel = 0; channel < emgChannels; ++channel) {
+			result.rms[channel] = std::sqrt(sumSquares[channel] * scale);
+			result.mav[channel] = sumAbs[channel] * scale;
+			result.zeroCrossings[channel] = static_cast<uint16_t>(crossings[channel]);
+		}
+		return result;
+	}
+
+	unsigned size() const
+	{
+		return count;
+	}
+
+	static const unsigned capacity = WindowSize;
+
+private:
+#ifdef EMG_FEATURES_SSE2
+	// widen() loads the eight channels of a sample as signed 16-bit lanes.
+	static __m128i widen(const int8_t* sample)
+	{
+		__m128i bytes = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(sample));
+		return _mm_srai_epi16(_mm_unpacklo_epi8(bytes, bytes), 8);
+	}
+
+	// SSE2 has no 16-bit absolute value, but |x| is max(x, -x).
+	static __m128i absolute(__m128i value)
+	{
+		return _mm_max_epi16(value, _mm_sub_epi16(_mm_setzero_si128(), value));
+	}
+
+	// low32() and high32() sign-extend four 16-bit lanes each to 32 bits.
+	static __m128i low32(__m128i value)
+	{
+		return _mm_srai_epi32(_mm_unpacklo_epi16(value, value), 16);
+	}
+
+	static __m128i high32(__m128i value)
+	{
+		return _mm_srai_epi32(_mm_unpackhi_epi16(value, value), 16);
+	}
+
+	// Squares reach 16384, which is positive in 16 bits, so they are zero-extended.
+	static __m128i lowUnsigned32(__m128i value)
+	{
+		return _mm_unpacklo_epi16(value, _mm_setzero_si128());
+	}
+
+	static __m128i highUnsigned32(__m128i value)
+	{
+		return _mm_unpackhi_epi16(value, _mm_setzero_si128());
+	}
+#endif
+
+	// The ring of samples; `newest` is the slot written last.
+	int8_t samples[WindowSize][emgChannels];
+	unsigned newest;
+	unsigned count;
+
+	int32_t sumAbs[emgChannels];
+	int32_t sumSquares[emgChannels];
+	int16_t crossings[emgChannels];
+};
@@ -0,0 +1,44 @@
+// Polynomial approximations of the inverse trigonometric functions used to turn quaternions into Euler angles.
+#pragma once
+
+#include <cmath>
+
+namespace fastmath {
+
+const float pi = 3.14159265f;
+
+// atanUnit() approximates atan(x) for 0 <= x <= 1 with a degree 9 odd polynomial (Abramowitz and Stegun 4.4.49). The
+// error is at most 1e-5 radians.
+inline float atanUnit(float x)
+{
+	float x2 = x * x;
+	return x * (0.9998660f + x2 * (-0.3302995f + x2 * (0.1801410f + x2 * (-0.0851330f + x2 * 0.0208351f))));
+}
+
+// atan2() approximates std::atan2(y, x) to within 2e-5 radians by reducing the argument to [0, 1] and fixing up the
+// octant afterwards.
+inline float atan2(float y, float x)
+{
+	float ax = std::fabs(x);
+	float ay = std::fabs(y);
+	if (ax == 0.0f && ay == 0.0f) {
+		return 0.0f;
+	}
+
+	float angle = ay > ax ? pi / 2.0f - atanUnit(ax / ay) : atanUnit(ay / ax);
+	if (x < 0.0f) {
+		angle = pi - angle;
+	}
+	return y < 0.0f ? -angle : angle;
+}
+
+// asin() approximates std::asin(x) for -1 <= x <= 1 to within 7e-5 radians (Abramowitz and Stegun 4.4.45).
+inline float asin(float x)
+{
+	float ax = std::fabs(x);
+	float angle = pi / 2.0f
+		- std::sqrt(1.0f - ax) * (1.5707288f + ax * (-0.2121144f + ax * (0.0742610f - ax * 0.0187293f)));
+	return x < 0.0f ? -angle : angle;
+}
+
+} // namespace fastmath
@@ -2,68 +2,463 @@
 // Distributed under the Myo SDK license agreement. See LICENSE.txt for details.
 #define _USE_MATH_DEFINES
 #include <cmath>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
 #include <iomanip>
 #include <stdexcept>
 #include <string>
 #include <algorithm>
-#include <ctime>
-#include <map>
+#include <csignal>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+#include <stdint.h>
 #include <stdlib.h>
 // The only file that needs to be included to use the Myo C++ SDK is myo.hpp.
 #include <myo/myo.hpp>
 
+#include "alphabet.hpp"
+#include "armband-recognition.hpp"
+#include "calibration.hpp"
+#include "console-renderer.hpp"
+#include "dtw-classifier.hpp"
+#include "emg-features.hpp"
+#include "latency-probes.hpp"
+#include "notifier.hpp"
+#include "orientation.hpp"
+#include "orientation-filters.hpp"
+#include "recognizer.hpp"
+#include "seqlock.hpp"
+#include "session-recorder.hpp"
+#include "session-replay.hpp"
+#include "spsc-queue.hpp"
+#include "telemetry-server.hpp"
+#include "timer-wheel.hpp"
+#include "word-dictionary.hpp"
+#include "https-backends.hpp"
+
+static_assert(poseRest == myo::Pose::rest && poseFist == myo::Pose::fist && poseWaveIn == myo::Pose::waveIn
+	&& poseWaveOut == myo::Pose::waveOut && poseFingersSpread == myo::Pose::fingersSpread
+	&& poseUnknown == myo::Pose::unknown,
+	"armband-recognition.hpp must use the SDK's pose values");
+
 // Classes that inherit from myo::DeviceListener can be used to receive events from Myo devices. DeviceListener
 // provides several virtual functions for handling different kinds of events. If you do not override an event, the
 // default behavior is to do nothing.
-
+//
+// The Policy is the stroke classifier each armband's recognizer uses (see stroke-classifiers.hpp). It is a template
+// parameter so that recognition is compiled and inlined separately for each strategy, without virtual calls per sample.
+template<typename Policy>
 class DataCollector : public myo::DeviceListener {
 public:
+	typedef BasicRecognizer<Policy> PolicyRecognizer;
+
+	// The most armbands one collector tracks at a time. Events from further Myos are ignored until one of the tracked
+	// armbands is unpaired.
+	static const unsigned maxArmbands = 4;
+
+	// EMG features are computed over the last 40 samples, which is 200 ms of the 200 Hz stream.
+	static const unsigned emgWindowSize = 40;
+
+	// Myos send orientation 50 times a second. With power saving, while an armband is resting it is only followed
+	// restingRate times a second, and the main loops render at restingRate while every armband rests.
+	static const unsigned orientationRate = 50;
+	static const unsigned restingRate = 5;
+
+	// Armband holds everything we know about one Myo, including its own recognizer, so that several people can type
+	// at once through a single Hub.
+	struct Armband {
+		Armband()
+			: device(0), paired(false), orphaned(false), onArm(false), whichArm(myo::armUnknown), isUnlocked(false),
+			roll_w(0), pitch_w(0), yaw_w(0), currentPose(), restingSamples(0)
+		{
+		}
+
+		// The Myo this slot belongs to, or null if the slot is free.
+		myo::Myo* device;
+
+		// Set while the Myo is paired. With keepUnpaired a slot outlives its pairing, see onUnpair().
+		bool paired;
+
+		// Set by forgetDevices() for a slot whose Myo belonged to a Hub that is gone. The slot is free, but it still
+		// holds that armband's text, so armbandFor() hands it to the next Myo it hasn't seen before.
+		bool orphaned;
+
+		// These values are set by onArmSync() and onArmUnsync() below.
+		bool onArm;
+		myo::Arm whichArm;
+
+		// This is set by onUnlocked() and onLocked() below.
+		bool isUnlocked;
+
+		// These values are set by onOrientationData() and onPose() below. The orientation is the filtered one.
+		float roll_w, pitch_w, yaw_w;
+		myo::Pose currentPose;
+
+		// The state of the filter stages the orientation goes through, see onOrientationData().
+		OrientationFilter filter;
+
+		// The recent EMG samples, filled by onEmgData() when EMG streaming is on.
+		EmgWindow<emgWindowSize> emg;
+
+		// Orientation samples that arrived while the armband was resting with power saving on, see
+		// onOrientationData().
+		unsigned restingSamples;
+	};
+
+	// DeviceState is what the Myo last told us about an armband, and TextState what its wearer has entered. Each is
+	// published whole by the one thread that changes it: the device state by the thread running the Hub, after every
+	// event that changes it, and the text by the thread running recognition, after every sample that changes the word.
+	// Any thread can read either at any time with deviceState() and textState(), without locking and without ever
+	// seeing half of an update, and publishing never waits for the readers.
+	struct DeviceState {
+		uint64_t timestamp;
+		float roll_w, pitch_w, yaw_w;
+		myo::Pose::Type pose;
+		bool onArm;
+		bool isUnlocked;
+		uint8_t arm;
+	};
+
+	typedef typename TextPublisher<PolicyRecognizer::wordCapacity>::State TextState;
+
 	DataCollector()
-		: onArm(false), isUnlocked(false), roll_w(0), pitch_w(0), yaw_w(0), currentPose()
+		: probes(LatencyProbes::instance()),
+		fastEuler(false),
+		streamEmg(false),
+		fuseGyroscope(false),
+		keepUnpaired(false),
+		powerSaving(false),
+		commandDevices(true),
+		recorder(0),
+		telemetry(0),
+		lastArmband(0),
+		pipelined(false),
+		stopping(false),
+		workerWaiting(false),
+		droppedSamples(0),
+		displayChanged(true),
+		calibrations(0),
+		alphabets(0)
+	{
+		for (unsigned i = 0; i < maxArmbands; ++i) {
+			users[i] = "default";
+			calibratedArms[i] = myo::armUnknown;
+		}
+	}
+
+	~DataCollector()
+	{
+		stopPipeline();
+	}
+
+	DeviceState deviceState(unsigned index) const
+	{
+		return shared[index].device.load();
+	}
+
+	TextState textState(unsigned index) const
+	{
+		return shared[index].text.load();
+	}
+
+	// setDictionary() turns on word prediction for every armband. The dictionary must outlive the collector.
+	void setDictionary(const WordDictionary* dictionary)
+	{
+		for (unsigned i = 0; i < maxArmbands; ++i) {
+			predictors[i].attach(dictionary);
+		}
+	}
+
+	// setCalibrationStore() has every recognizer calibrate itself to the person wearing its armband, starting from the
+	// profile the store has for them on that arm. Who is wearing which armband is set in `users`. The store must
+	// outlive the collector.
+	void setCalibrationStore(CalibrationStore* store)
+	{
+		calibrations = store;
+		for (unsigned i = 0; i < maxArmbands; ++i) {
+			recognizers[i].calibrating = store != 0;
+		}
+	}
+
+	// saveCalibration() hands what every recognizer has learned back to the store and saves it. Profiles are also
+	// saved whenever an armband leaves an arm or is unpaired. It must not be called while the pipeline is running.
+	void saveCalibration()
+	{
+		for (unsigned i = 0; i < maxArmbands; ++i) {
+			storeCalibration(i);
+		}
+		if (calibrations && !calibrations->save()) {
+			std::cerr << "Unable to save the calibration" << std::endl;
+		}
+	}
+
+	// setAlphabets() has every recognizer look up strokes in its user's alphabet from the library, which must outlive
+	// the collector. Call it after setting `users`.
+	void setAlphabets(AlphabetLibrary* library)
 	{
+		alphabets = library;
+		for (unsigned i = 0; i < maxArmbands; ++i) {
+			recognizers[i].alphabet = &library->slotFor(users[i]);
+		}
+	}
+
+	// setStrokeTemplates() has every recognizer's classifier match strokes against its user's templates from the
+	// library, which must outlive the collector. Call it after setting `users`. It returns false if this build's
+	// classifier doesn't use templates.
+	bool setStrokeTemplates(const DtwTemplateLibrary& library)
+	{
+		for (unsigned i = 0; i < maxArmbands; ++i) {
+			if (!useTemplates(recognizers[i].classifier, library.setFor(users[i]))) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	// reloadAlphabets() picks up alphabet files that have changed, checking at most once a second. The recognizers
+	// switch over at their next lookup. It is called from runHub()'s loop; the event-driven loop checks on a timer
+	// instead, see ReloadTimer.
+	void reloadAlphabets()
+	{
+		std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+		if (alphabets && now - lastAlphabetCheck >= std::chrono::seconds(1)) {
+			lastAlphabetCheck = now;
+			alphabets->reloadChanged(std::cerr);
+		}
+	}
+
+	// startPipeline() moves recognition onto its own thread. From then on the event callbacks only queue samples, so
+	// they return quickly however long recognition takes. It must be called before the collector is added to a Hub.
+	void startPipeline()
+	{
+		if (!pipelined) {
+			pipelined = true;
+			stopping = false;
+			worker = std::thread(&DataCollector::runPipeline, this);
+		}
+	}
+
+	// stopPipeline() recognizes any samples still queued and then stops the recognition thread.
+	void stopPipeline()
+	{
+		if (pipelined) {
+			{
+				std::lock_guard<std::mutex> lock(wakeMutex);
+				stopping = true;
+			}
+			wake.notify_one();
+			worker.join();
+			pipelined = false;
+		}
+	}
+
+	// onPair() is called whenever a new Myo has been paired.
+	void onPair(myo::Myo* myo, uint64_t timestamp, myo::FirmwareVersion firmwareVersion)
+	{
+		Armband* armband = armbandFor(myo);
+		if (armband) {
+			record(makeSessionRecord(recordPair, indexOf(*armband), timestamp));
+			armband->paired = true;
+			publishDevice(*armband, timestamp);
+			displayChanged = true;
+		}
+		enableEmg(myo);
+	}
+
+	// onConnect() is called whenever a paired Myo has been connected. A Myo forgets its streaming settings when it
+	// disconnects, so EMG streaming is turned on again here.
+	void onConnect(myo::Myo* myo, uint64_t timestamp, myo::FirmwareVersion firmwareVersion)
+	{
+		enableEmg(myo);
 	}
 
 	// onUnpair() is called whenever the Myo is disconnected from Myo Connect by the user.
 	void onUnpair(myo::Myo* myo, uint64_t timestamp)
 	{
 		// We've lost a Myo.
-		// Let's clean up some leftover state.
-		roll_w = 0;
-		pitch_w = 0;
-		yaw_w = 0;
-		onArm = false;
-		isUnlocked = false;
+		for (unsigned i = 0; i < maxArmbands; ++i) {
+			if (armbands[i].device == myo) {
+				record(makeSessionRecord(recordUnpair, i, timestamp));
+				if (keepUnpaired) {
+					// Keep the slot, and with it the text and calibration, for when the Myo pairs again. The sample
+					// tells the recognizer the armband is off the arm, which saves its calibration.
+					Armband& armband = armbands[i];
+					armband.paired = false;
+					armband.onArm = false;
+					armband.isUnlocked = false;
+					armband.currentPose = myo::Pose();
+					submit(sampleFor(armband, RecognitionSample::sampleOrientation, timestamp));
+				}
+				else {
+					// Let's clean up some leftover state so its slot can be reused.
+					armbands[i] = Armband();
+					submit(sampleFor(armbands[i], RecognitionSample::sampleReset, timestamp));
+				}
+				publishDevice(armbands[i], timestamp);
+				displayChanged = true;
+			}
+		}
+	}
+
+	// forgetDevices() is called after the Hub has gone away, taking its myo::Myo objects with it. Every slot gives up
+	// its Myo but keeps its text and calibration, and is adopted by the first new Myo to send an event, see
+	// armbandFor(). With one armband, that is the same armband coming back.
+	void forgetDevices()
+	{
+		for (unsigned i = 0; i < maxArmbands; ++i) {
+			Armband& armband = armbands[i];
+			if (armband.device) {
+				armband.device = 0;
+				armband.paired = false;
+				armband.orphaned = true;
+				armband.onArm = false;
+				armband.isUnlocked = false;
+				armband.currentPose = myo::Pose();
+				publishDevice(armband, 0);
+			}
+		}
+		lastArmband = 0;
+		displayChanged = true;
 	}
 
 	// onOrientationData() is called whenever the Myo device provides its current orientation, which is represented
 	// as a unit quaternion.
 	void onOrientationData(myo::Myo* myo, uint64_t timestamp, const myo::Quaternion<float>& quat)
 	{
-		using std::atan2;
-		using std::asin;
-		using std::sqrt;
-		using std::max;
-		using std::min;
+		Armband* armband = armbandFor(myo);
+		if (!armband) {
+			return;
+		}
 
-		// Calculate Euler angles (roll, pitch, and yaw) from the unit quaternion.
-		float roll = atan2(2.0f * (quat.w() * quat.x() + quat.y() * quat.z()),
-			1.0f - 2.0f * (quat.x() * quat.x() + quat.y() * quat.y()));
-		float pitch = asin(max(-1.0f, min(1.0f, 2.0f * (quat.w() * quat.y() - quat.z() * quat.x()))));
-		float yaw = atan2(2.0f * (quat.w() * quat.z() + quat.x() * quat.y()),
-			1.0f - 2.0f * (quat.y() * quat.y() + quat.z() * quat.z()));
+		if (recorder) {
+			SessionRecord orientation = makeSessionRecord(recordOrientation, indexOf(*armband), timestamp);
+			orientation.values[0] = quat.x();
+			orientation.values[1] = quat.y();
+			orientation.values[2] = quat.z();
+			orientation.values[3] = quat.w();
+			record(orientation);
+		}
+
+		// A resting armband only has its orientation followed at restingRate, and not recognized at all: strokes only
+		// count once the armband is unlocked and on an arm. The first sample after an unlock or a sync is back at the
+		// full rate, since the state is checked sample by sample. Every sample is still recorded, above.
+		bool resting = powerSaving && isResting(*armband);
+		if (resting && armband->restingSamples++ % (orientationRate / restingRate) != 0) {
+			return;
+		}
+		if (!resting) {
+			armband->restingSamples = 0;
+		}
+
+		// Calculate Euler angles (roll, pitch, and yaw) from the unit quaternion and convert them to a scale from 0
+		// to 18, see orientation.hpp.
+		ScaledOrientation scaled = scaleOrientation(quat.x(), quat.y(), quat.z(), quat.w(), fastEuler);
+		// Filtering happens once, here, so the display and the recognizer see the same smoothed values.
+		scaled = armband->filter.filter(scaled, timestamp, filtering);
+		if (telemetry) {
+			TelemetryEvent event = makeTelemetryEvent(telemetryOrientation, indexOf(*armband), timestamp);
+			event.values[0] = scaled.roll_w;
+			event.values[1] = scaled.pitch_w;
+			event.values[2] = scaled.yaw_w;
+			telemetry->publish(TelemetryServer::sourceEvents, event);
+		}
+		if (armband->onArm && armband->isUnlocked && (barLength(scaled.roll_w) != barLength(armband->roll_w)
+			|| barLength(scaled.pitch_w) != barLength(armband->pitch_w) || barLength(scaled.yaw_w) != barLength(armband->yaw_w))) {
+			displayChanged = true;
+		}
+		armband->roll_w = scaled.roll_w;
+		armband->pitch_w = scaled.pitch_w;
+		armband->yaw_w = scaled.yaw_w;
+		publishDevice(*armband, timestamp);
+
+		// A locked armband's samples would be tracked as strokes at a fraction of the rate, so they are left out. Those
+		// of an armband off the arm still go, at restingRate, for the recognizer to let go of the arm's calibration.
+		if (!resting || !armband->onArm) {
+			submit(sampleFor(*armband, RecognitionSample::sampleOrientation, timestamp));
+		}
+	}
+
+	// onEmgData() is called with each sample of the eight EMG channels while EMG streaming is on, 200 times a second.
+	void onEmgData(myo::Myo* myo, uint64_t timestamp, const int8_t* emg)
+	{
+		Armband* armband = armbandFor(myo);
+		if (!armband) {
+			return;
+		}
+		if (recorder) {
+			SessionRecord emgRecord = makeSessionRecord(recordEmg, indexOf(*armband), timestamp);
+			std::memcpy(emgRecord.values, emg, emgChannels);
+			record(emgRecord);
+		}
+
+		armband->emg.push(emg);
+	}
+
+	// onGyroscopeData() is called with the angular velocity of the arm with each IMU sample, 50 times a second, just
+	// after onOrientationData(). With fusion on it is what tells the recognizer when strokes start and end.
+	void onGyroscopeData(myo::Myo* myo, uint64_t timestamp, const myo::Vector3<float>& gyro)
+	{
+		Armband* armband = armbandFor(myo);
+		if (!armband) {
+			return;
+		}
+		if (recorder) {
+			SessionRecord gyroscope = makeSessionRecord(recordGyroscope, indexOf(*armband), timestamp);
+			gyroscope.values[0] = gyro.x();
+			gyroscope.values[1] = gyro.y();
+			gyroscope.values[2] = gyro.z();
+			record(gyroscope);
+		}
+		if (!fuseGyroscope || !armband->onArm || (powerSaving && isResting(*armband))) {
+			return;
+		}
 
-		// Convert the floating point angles in radians to a scale from 0 to 18.
-		roll_w = static_cast<float>((roll + (float)M_PI) / (M_PI * 2.0f) * 18);
-		pitch_w = static_cast<float>((pitch + (float)M_PI / 2.0f) / M_PI * 18);
-		yaw_w = static_cast<float>((yaw + (float)M_PI) / (M_PI * 2.0f) * 18);
+		RecognitionSample sample = sampleFor(*armband, RecognitionSample::sampleGyroscope, timestamp);
+		sample.rates[0] = gyro.x();
+		sample.rates[1] = gyro.y();
+		sample.rates[2] = gyro.z();
+		submit(sample);
 	}
 
 	// onPose() is called whenever the Myo detects that the person wearing it has changed their pose, for example,
 	// making a fist, or not making a fist anymore.
 	void onPose(myo::Myo* myo, uint64_t timestamp, myo::Pose pose)
 	{
-		currentPose = pose;
+		Armband* armband = armbandFor(myo);
+		if (!armband) {
+			return;
+		}
+		if (recorder) {
+			SessionRecord poseRecord = makeSessionRecord(recordPose, indexOf(*armband), timestamp);
+			poseRecord.code = static_cast<uint16_t>(pose.type());
+			record(poseRecord);
+		}
+
+		// Only a change of pose is an event for us. A repeat of the current pose doesn't fire actions again or keep the
+		// Myo unlocking and vibrating.
+		if (!takePoseChange(armband->currentPose, pose)) {
+			return;
+		}
+		publishDevice(*armband, timestamp);
+		displayChanged = true;
+		if (telemetry) {
+			TelemetryEvent event = makeTelemetryEvent(telemetryPose, indexOf(*armband), timestamp);
+			event.code = static_cast<uint16_t>(pose.type());
+			telemetry->publish(TelemetryServer::sourceEvents, event);
+		}
+		submit(sampleFor(*armband, RecognitionSample::samplePose, timestamp));
+
+		if (!commandDevices) {
+			return;
+		}
 
 		if (pose != myo::Pose::unknown && pose != myo::Pose::rest) {
 			// Tell the Myo to stay unlocked until told otherwise. We do that here so you can hold the poses without the
@@ -86,19 +481,20 @@ public:
 	void onArmSync(myo::Myo* myo, uint64_t timestamp, myo::Arm arm, myo::XDirection xDirection, float rotation,
 		myo::WarmupState warmupState)
 	{
-		onArm = true;
-		whichArm = arm;
-	}
+		Armband* armband = armbandFor(myo);
+		if (armband) {
+			SessionRecord sync = makeSessionRecord(recordArmSync, indexOf(*armband), timestamp);
+			sync.code = static_cast<uint16_t>(arm);
+			sync.extra = static_cast<uint32_t>(xDirection);
+			sync.values[0] = rotation;
+			sync.values[1] = static_cast<float>(warmupState);
+			record(sync);
 
-	std::string matchLetterToGesture(std::string gesture)
-	{
-		using namespace std;
-		map<string, string> letterMap;
-		letterMap[""] = " "; letterMap["pitchyawpitch"] = "a"; letterMap["rollpitch"] = "b"; letterMap["roll"] = "c";
-		letterMap["rollpitch"] = "d"; letterMap["rollpitchyaw"] = "e"; letterMap["pitchpitchyaw"] = "f"; 
-		letterMap["rollpitchyaw"] = "g"; letterMap["pitchroll"] = "h"; letterMap["yawpitchyaw"] = "i";
-		letterMap["yawpitchroll"] = "j"; letterMap["pitchyawyaw"] = "k";
-		return letterMap[gesture];
+			armband->onArm = true;
+			displayChanged = true;
+			armband->whichArm = arm;
+			publishDevice(*armband, timestamp);
+		}
 	}
 
 	// onArmUnsync() is called whenever Myo has detected that it was moved from a stable position on a person's arm after
@@ -106,148 +502,1091 @@ public:
 	// when Myo is moved around on the arm.
 	void onArmUnsync(myo::Myo* myo, uint64_t timestamp)
 	{
-		onArm = false;
+		Armband* armband = armbandFor(myo);
+		if (armband) {
+			record(makeSessionRecord(recordArmUnsync, indexOf(*armband), timestamp));
+			armband->onArm = false;
+			publishDevice(*armband, timestamp);
+			displayChanged = true;
+		}
 	}
 
 	// onUnlock() is called whenever Myo has become unlocked, and will start delivering pose events.
 	void onUnlock(myo::Myo* myo, uint64_t timestamp)
 	{
-		isUnlocked = true;
+		Armband* armband = armbandFor(myo);
+		if (armband) {
+			record(makeSessionRecord(recordUnlock, indexOf(*armband), timestamp));
+			armband->isUnlocked = true;
+			publishDevice(*armband, timestamp);
+			displayChanged = true;
+		}
 	}
 
 	// onLock() is called whenever Myo has become locked. No pose events will be sent until the Myo is unlocked again.
+	// Without power saving the Myo is unlocked again at once, so it never stays locked; with it the Myo stays locked,
+	// which saves its battery, until someone unlocks it with the unlock gesture.
 	void onLock(myo::Myo* myo, uint64_t timestamp)
 	{
-		isUnlocked = false;
-		myo->unlock(myo::Myo::unlockTimed);
+		Armband* armband = armbandFor(myo);
+		if (armband) {
+			record(makeSessionRecord(recordLock, indexOf(*armband), timestamp));
+			armband->isUnlocked = false;
+			publishDevice(*armband, timestamp);
+			displayChanged = true;
+		}
+		if (commandDevices && !powerSaving) {
+			myo->unlock(myo::Myo::unlockTimed);
+		}
+	}
+
+	// isResting() tells whether an armband has nothing for us to recognize: it is locked, or not on an arm.
+	static bool isResting(const Armband& armband)
+	{
+		return !armband.onArm || !armband.isUnlocked;
+	}
+
+	// allResting() tells whether every tracked armband is resting, in which case the main loops slow down to
+	// restingRate when power saving is on.
+	bool allResting() const
+	{
+		for (unsigned i = 0; i < maxArmbands; ++i) {
+			if (armbands[i].device && !isResting(armbands[i])) {
+				return false;
+			}
+		}
+		return true;
 	}
 
 	// There are other virtual functions in DeviceListener that we could override here, like onAccelerometerData().
-	// For this example, the functions overridden above are sufficient.
+	// The orientation already combines the accelerometer with the gyroscope, so the functions overridden above are
+	// sufficient.
+
+	// enableEmg() asks a Myo to stream EMG if that was requested.
+	void enableEmg(myo::Myo* myo)
+	{
+		if (streamEmg && commandDevices) {
+			myo->setStreamEmg(myo::Myo::streamEmgEnabled);
+		}
+	}
 
-	// We define this function to print the current values that were updated by the on...() functions above.
+	// We define this function to print the current values that were updated by the on...() functions above. Gesture
+	// recognition itself happens in the event callbacks, so print() only displays state. Each tracked armband gets its
+	// own set of fields on the line. The line is built in the renderer and only reaches the console when it changes.
 	void print()
 	{
+		renderer.begin();
+
 		// Clear the current line
-		std::cout << '\r';
+		renderer.put('\r');
+
+		for (unsigned i = 0; i < maxArmbands; ++i) {
+			if (armbands[i].device) {
+				print(armbands[i]);
+			}
+		}
+
+		renderer.present(std::cout);
+	}
+
+	void print(const Armband& armband)
+	{
+		// The state shown is the published one, so printing doesn't depend on running on the Hub's thread.
+		DeviceState state = deviceState(indexOf(armband));
 
 		// Print out the orientation. Orientation data is always available, even if no arm is currently recognized.
-		std::cout << '[' << std::string(roll_w, '*') << std::string(18 - roll_w, ' ') << ']'
-		<< '[' << std::string(pitch_w, '*') << std::string(18 - pitch_w, ' ') << ']'
-		<< '[' << std::string(yaw_w, '*') << std::string(18 - yaw_w, ' ') << ']';
-
-		if (onArm) {
-			// Print out the lock state, the currently recognized pose, and which arm Myo is being worn on.
-
-			// Pose::toString() provides the human-readable name of a pose. We can also output a Pose directly to an
-			// output stream (e.g. std::cout << currentPose;). In this case we want to get the pose name's length so
-			// that we can fill the rest of the field with spaces below, so we obtain it as a string using toString().
-			std::string poseString = currentPose.toString();
-
-			std::cout << '[' << (isUnlocked ? "unlocked" : "locked  ") << ']'
-				<< '[' << (whichArm == myo::armLeft ? "L" : "R") << ']'
-				<< '[' << poseString << std::string(14 - poseString.size(), ' ') << ']';
-			if (poseString == "fist") {
-				std::cout << "fist\n";
-				//std::cin.get();
-				home_roll = roll_w;
-				home_yaw = yaw_w;
-				home_pitch = pitch_w;
-				double curr_time = time(NULL);
-				while (time(NULL) - curr_time < 2);
-				std::string letter = matchLetterToGesture(gestures);
-				std::cout << letter << std::endl;;
-				gestures = "";
-				word += letter;
-				std::cout << word << std::endl;
-				//flush gesture matrix to letter
-				//set home
-				//pause
+		printBar(state.roll_w);
+		printBar(state.pitch_w);
+		printBar(state.yaw_w);
+
+		// With EMG streaming on, show the muscle activity as the mean RMS over the channels, from 0 to 128. It
+		// updates whenever the line is redrawn rather than causing redraws itself.
+		if (streamEmg) {
+			EmgFeatures features = armband.emg.features();
+			float total = 0;
+			for (unsigned i = 0; i < emgChannels; ++i) {
+				total += features.rms[i];
 			}
-			else if (poseString == "fingersSpread") {
-				std::string command = "python testgrid.py " + word;
-				system(command.c_str());
+			renderer.put("[emg");
+			renderer.putNumber(static_cast<unsigned>(total / emgChannels), 4);
+			renderer.put(']');
+		}
+
+		if (state.onArm) {
+			// Print out the lock state, the currently recognized pose, and which arm Myo is being worn on. The pose
+			// name is padded with spaces to the width of the longest one.
+			const char* poseString = poseName(state.pose);
+
+			renderer.put('[');
+			renderer.put(state.isUnlocked ? "unlocked" : "locked  ");
+			renderer.put("][");
+			renderer.put(state.arm == myo::armLeft ? 'L' : 'R');
+			renderer.put("][");
+			renderer.put(poseString);
+			renderer.fill(' ', 14 - static_cast<unsigned>(std::strlen(poseString)));
+			renderer.put(']');
+		}
+		else {
+			// Print out a placeholder for the arm and pose when Myo doesn't currently know which arm it's on.
+			renderer.put('[');
+			renderer.fill(' ', 8);
+			renderer.put("][?][");
+			renderer.fill(' ', 14);
+			renderer.put(']');
+		}
+	}
+
+	// printBar() prints an orientation value on the 0 to 18 scale as a bar of stars.
+	void printBar(float value)
+	{
+		unsigned filled = barLength(value);
+		renderer.put('[');
+		renderer.fill('*', filled);
+		renderer.fill(' ', 18 - filled);
+		renderer.put(']');
+	}
+
+	// barLength() is the number of stars printBar() shows for a value.
+	static unsigned barLength(float value)
+	{
+		return static_cast<unsigned>(std::max(0, std::min(18, static_cast<int>(value))));
+	}
+
+	// poseName() is the name Pose::toString() gives a pose, without building a std::string.
+	static const char* poseName(myo::Pose::Type type)
+	{
+		switch (type) {
+		case myo::Pose::rest:
+			return "rest";
+		case myo::Pose::fist:
+			return "fist";
+		case myo::Pose::waveIn:
+			return "waveIn";
+		case myo::Pose::waveOut:
+			return "waveOut";
+		case myo::Pose::fingersSpread:
+			return "fingersSpread";
+		case myo::Pose::doubleTap:
+			return "doubleTap";
+		default:
+			return "unknown";
+		}
+	}
+
+	// sampleFor() captures the state of an armband that recognition needs at the time of an event. With latency probes
+	// on it also notes when the event arrived, and how long after its SDK timestamp.
+	RecognitionSample sampleFor(const Armband& armband, RecognitionSample::Kind kind, uint64_t timestamp)
+	{
+		RecognitionSample sample;
+		sample.received = 0;
+		if (probes.isEnabled()) {
+			sample.received = probeClock();
+			// Replayed events arrive as fast as they can be read, so only live ones have a meaningful delay.
+			if (commandDevices && kind != RecognitionSample::sampleReset) {
+				probes.record(spanEventDelay, indexOf(armband), static_cast<int64_t>(timestamp) * 1000, sample.received);
 			}
-			else if (poseString == "waveOut") {
-				std::string command = "python testtwil.py " + word;
-				system(command.c_str());
+		}
+
+		sample.kind = static_cast<uint8_t>(kind);
+		sample.armband = static_cast<uint8_t>(indexOf(armband));
+		sample.onArm = armband.onArm;
+		sample.arm = static_cast<uint8_t>(armband.whichArm);
+		sample.pose = static_cast<uint16_t>(armband.currentPose.type());
+		sample.timestamp = timestamp;
+		sample.roll_w = armband.roll_w;
+		sample.pitch_w = armband.pitch_w;
+		sample.yaw_w = armband.yaw_w;
+		sample.rates[0] = sample.rates[1] = sample.rates[2] = 0;
+		return sample;
+	}
+
+	// submit() hands a sample to recognition: directly on this thread, or through the queue in pipeline mode. When
+	// the queue is full orientation samples are dropped, since the next one supersedes them anyway, but pose and reset
+	// samples wait for room so that letters and unpairs are never lost.
+	void submit(const RecognitionSample& sample)
+	{
+		if (!pipelined) {
+			recognize(sample);
+			publishText(sample.armband);
+			return;
+		}
+
+		while (!samples.push(sample)) {
+			if (sample.kind == RecognitionSample::sampleOrientation) {
+				++droppedSamples;
+				return;
 			}
-			else {
-				if (epsilonCompare(roll_w,home_roll,0.7) && epsilonCompare(pitch_w, home_pitch, 0.7) && epsilonCompare(yaw_w,home_yaw,0.7)) {
-					std::cout << "home reached\n";
-					std::cout << max_roll << std::endl;
-					std::cout << max_pitch << std::endl;
-					std::cout << max_yaw << std::endl;
-					/**max_roll /= home_roll;
-					max_yaw /= home_yaw;
-					max_pitch /= home_pitch;**/
-					if (max_yaw > max_roll && max_yaw > max_pitch) {
-						std::cout << "yaw\n"; gestures += "yaw";
-					}
-					if (max_roll > max_yaw && max_roll > max_pitch) {
-						std::cout << "roll\n"; gestures += "roll";
-					}
-					if (max_pitch > max_roll && max_pitch > max_yaw) {
-						std::cout << "pitch\n"; gestures += "pitch";
-					}
-					//std::cin.get();
-					double curr_time = time(NULL);
-					while (time(NULL) - curr_time < 2);
-					max_roll = 0;
-					max_yaw = 0;
-					max_pitch = 0;
+			std::this_thread::yield();
+		}
+
+		// The fence pairs with the one in runPipeline(): either the worker sees this sample before it sleeps, or we
+		// see that it is going to sleep and wake it. Taking the lock makes sure it has started waiting.
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (workerWaiting.load(std::memory_order_relaxed)) {
+			std::lock_guard<std::mutex> lock(wakeMutex);
+			wake.notify_one();
+		}
+	}
+
+	// recognize() runs an armband's recognizer against one sample, see recognizeSample(), and follows up on what it
+	// did. It is called for every orientation and pose event, so every IMU sample is seen rather than only the ones
+	// print() happens to poll.
+	void recognize(const RecognitionSample& sample)
+	{
+		PolicyRecognizer& recognizer = recognizers[sample.armband];
+		bool onArm = sample.kind != RecognitionSample::sampleReset && sample.onArm;
+		selectCalibration(sample.armband, onArm ? static_cast<myo::Arm>(sample.arm) : myo::armUnknown);
+		RecognitionOutcome outcome = recognizeSample(recognizer, predictors[sample.armband], sample);
+
+		if (outcome.strokeEnded) {
+			probe(spanHomeReached, sample);
+		}
+		if (outcome.action == actionSendEmail || outcome.action == actionSendSms) {
+			if (notifier.post(outcome.action == actionSendEmail ? channelEmail : channelSms, recognizer.word.c_str())) {
+				probe(spanMessagePosted, sample);
+			}
+		}
+		else if (outcome.action == actionLetter && recognizer.word.size() > outcome.appendedFrom) {
+			probe(spanLetterDecoded, sample);
+		}
+		for (unsigned i = outcome.appendedFrom; i < recognizer.word.size(); ++i) {
+			publishLetter(sample, recognizer.word.c_str()[i]);
+		}
+		if (outcome.redraw) {
+			renderer.invalidate();
+			displayChanged = true;
+		}
+	}
+
+	// selectCalibration() switches an armband's recognizer to the profile of its user on `arm` when the armband has
+	// moved to another arm, first saving what it learned on the previous one. armUnknown means off any arm.
+	void selectCalibration(unsigned index, myo::Arm arm)
+	{
+		if (!calibrations || arm == calibratedArms[index]) {
+			return;
+		}
+		if (calibratedArms[index] != myo::armUnknown) {
+			storeCalibration(index);
+			if (!calibrations->save()) {
+				std::cerr << "Unable to save the calibration" << std::endl;
+			}
+		}
+		calibratedArms[index] = arm;
+		if (arm == myo::armUnknown) {
+			return;
+		}
+
+		PolicyRecognizer& recognizer = recognizers[index];
+		recognizer.calibration = calibrations->find(users[index], armName(arm));
+		if (recognizer.verbose) {
+			std::cout << "calibration for " << users[index] << " on the " << armName(arm) << " arm: "
+				<< recognizer.calibration.strokeCount() << " strokes, home within " << recognizer.calibration.tolerance(0)
+				<< '/' << recognizer.calibration.tolerance(1) << '/' << recognizer.calibration.tolerance(2) << '\n';
+			renderer.invalidate();
+		}
+	}
+
+	// storeCalibration() copies what an armband's recognizer has learned into the store.
+	void storeCalibration(unsigned index)
+	{
+		if (calibrations && calibratedArms[index] != myo::armUnknown) {
+			calibrations->update(users[index], armName(calibratedArms[index]), recognizers[index].calibration);
+		}
+	}
+
+	static const char* armName(myo::Arm arm)
+	{
+		return arm == myo::armLeft ? "left" : "right";
+	}
+
+	// publishLetter() tells telemetry subscribers that a letter was appended to the sample's armband's word.
+	void publishLetter(const RecognitionSample& sample, char letter)
+	{
+		if (telemetry) {
+			TelemetryEvent event = makeTelemetryEvent(telemetryLetter, sample.armband, sample.timestamp);
+			event.code = static_cast<unsigned char>(letter);
+			telemetry->publish(TelemetryServer::sourceRecognition, event);
+		}
+	}
+
+	static TelemetryEvent makeTelemetryEvent(TelemetryEventType type, unsigned armband, uint64_t timestamp)
+	{
+		TelemetryEvent event;
+		std::memset(&event, 0, sizeof(event));
+		event.timestamp = timestamp;
+		event.type = static_cast<uint8_t>(type);
+		event.armband = static_cast<uint8_t>(armband);
+		return event;
+	}
+
+	// probe() records a span from the arrival of a sample's event to now.
+	void probe(LatencySpan span, const RecognitionSample& sample)
+	{
+		if (sample.received) {
+			probes.record(span, sample.armband, sample.received, probeClock());
+		}
+	}
+
+	// runPipeline() is the body of the recognition thread. When the queue runs dry it sleeps until submit() wakes it,
+	// so an idle pipeline doesn't wake up at all.
+	void runPipeline()
+	{
+		RecognitionSample sample;
+		for (;;) {
+			if (samples.pop(sample)) {
+				recognize(sample);
+				publishText(sample.armband);
+				continue;
+			}
+			if (stopping) {
+				return;
+			}
+
+			std::unique_lock<std::mutex> lock(wakeMutex);
+			workerWaiting.store(true, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			wake.wait(lock, [this] { return !samples.empty() || stopping; });
+			workerWaiting.store(false, std::memory_order_relaxed);
+		}
+	}
+
+	// publishDevice() publishes the state of an armband, see DeviceState. It is called from the event callbacks.
+	void publishDevice(const Armband& armband, uint64_t timestamp)
+	{
+		DeviceState state;
+		state.timestamp = timestamp;
+		state.roll_w = armband.roll_w;
+		state.pitch_w = armband.pitch_w;
+		state.yaw_w = armband.yaw_w;
+		state.pose = armband.currentPose.type();
+		state.onArm = armband.onArm;
+		state.isUnlocked = armband.isUnlocked;
+		state.arm = static_cast<uint8_t>(armband.whichArm);
+		shared[indexOf(armband)].device.store(state);
+	}
+
+	// publishText() publishes an armband's word if a sample has changed it, see TextState. It is called after each
+	// sample is recognized.
+	void publishText(unsigned index)
+	{
+		shared[index].text.publish(recognizers[index].word);
+	}
+
+	// record() passes an event to the session recorder, if one is attached.
+	void record(const SessionRecord& event)
+	{
+		if (recorder) {
+			recorder->record(event);
+		}
+	}
+
+	unsigned indexOf(const Armband& armband) const
+	{
+		return static_cast<unsigned>(&armband - armbands);
+	}
+
+	// armbandFor() returns the slot for a Myo, claiming a free one the first time the Myo is seen, or null if every
+	// slot is taken. Orphaned slots are claimed before empty ones, and when there is neither, a slot kept for a Myo
+	// that is no longer paired is cleared and reused. All callbacks arrive on the thread that calls Hub::run(), so the
+	// table needs no locking. Events tend to come in runs from the same Myo, so the last slot found is checked first.
+	Armband* armbandFor(myo::Myo* myo)
+	{
+		if (lastArmband && lastArmband->device == myo) {
+			return lastArmband;
+		}
+
+		Armband* freeSlot = 0;
+		Armband* unpairedSlot = 0;
+		for (unsigned i = 0; i < maxArmbands; ++i) {
+			Armband& armband = armbands[i];
+			if (armband.device == myo) {
+				return lastArmband = &armband;
+			}
+			if (!armband.device && (!freeSlot || (armband.orphaned && !freeSlot->orphaned))) {
+				freeSlot = &armband;
+			}
+			if (armband.device && !armband.paired && !unpairedSlot) {
+				unpairedSlot = &armband;
+			}
+		}
+
+		if (!freeSlot && unpairedSlot) {
+			*unpairedSlot = Armband();
+			submit(sampleFor(*unpairedSlot, RecognitionSample::sampleReset, 0));
+			freeSlot = unpairedSlot;
+		}
+		if (freeSlot) {
+			freeSlot->device = myo;
+			freeSlot->paired = true;
+			freeSlot->orphaned = false;
+		}
+		return lastArmband = freeSlot;
+	}
+
+	LatencyProbes& probes;
+
+	// Set to convert orientation with the approximations in fast-math.hpp, see scaleOrientation().
+	bool fastEuler;
+
+	// The filter stages every orientation sample goes through, none by default.
+	FilterSettings filtering;
+
+	// Set to have every Myo stream EMG, see onEmgData().
+	bool streamEmg;
+
+	// Set to have the recognizers segment strokes by the gyroscope, see onGyroscopeData(). The recognizers' own fusion
+	// settings must be set to match.
+	bool fuseGyroscope;
+
+	// Set to keep an armband's slot, text and calibration when its Myo is unpaired, so that it carries on where it left
+	// off when it pairs again. Without it an unpaired slot is cleared.
+	bool keepUnpaired;
+
+	// Set to let Myos lock when they are idle, and to slow down while they are locked or off the arm; see onLock()
+	// and onOrientationData().
+	bool powerSaving;
+
+	// Cleared when events come from a SessionReplay, whose myo::Myo pointers are not real devices and must not be
+	// told to unlock or vibrate.
+	bool commandDevices;
+
+	// When set, every event from a tracked armband is written to this recorder before it is handled.
+	SessionRecorder* recorder;
+
+	// When set, orientation, poses and entered letters are published to this server's subscribers.
+	TelemetryServer* telemetry;
+
+	Armband armbands[maxArmbands];
+	Armband* lastArmband;
+
+	// One recognizer per armband slot. In pipeline mode they belong to the recognition thread, and the event thread
+	// only reaches them through the sample queue.
+	PolicyRecognizer recognizers[maxArmbands];
+
+	// One word predictor per armband slot, following its recognizer's word. Like the recognizers they belong to the
+	// recognition thread in pipeline mode.
+	WordPredictor predictors[maxArmbands];
+
+	// The published state of each armband slot, see DeviceState.
+	struct SharedState {
+		Seqlock<DeviceState> device;
+		TextPublisher<PolicyRecognizer::wordCapacity> text;
+	};
+	SharedState shared[maxArmbands];
+
+	// Pipeline mode state, see startPipeline().
+	bool pipelined;
+	SpscQueue<RecognitionSample, 1024> samples;
+	std::thread worker;
+	std::atomic<bool> stopping;
+	std::atomic<bool> workerWaiting;
+	std::mutex wakeMutex;
+	std::condition_variable wake;
+
+	// Orientation samples dropped because the recognition thread fell behind.
+	unsigned droppedSamples;
+
+	// Set whenever something print() shows may have changed, so that the event-driven main loop only renders when it
+	// has to. Orientation only counts while the armband is on an arm and unlocked, so a locked or idle armband doesn't
+	// keep waking the renderer. It is atomic because the recognition thread sets it after echoing.
+	std::atomic<bool> displayChanged;
+
+	// Builds the status line for print(). The recognizers' echo is printed over it, so they invalidate it.
+	ConsoleRenderer renderer;
+
+	// Sends an armband's word by email on fingersSpread and by SMS on waveOut, off the event thread.
+	NotificationDispatcher notifier;
+
+	// Where calibration profiles are kept, or null if the recognizers don't calibrate; see setCalibrationStore().
+	// Who wears each armband slot, named in the store.
+	CalibrationStore* calibrations;
+	std::string users[maxArmbands];
+
+	// The alphabets loaded from files, or null if the recognizers use the built-in one; see setAlphabets().
+	AlphabetLibrary* alphabets;
+	std::chrono::steady_clock::time_point lastAlphabetCheck;
+
+	// The arm each recognizer's calibration belongs to, or armUnknown if it has none. Like the recognizers these
+	// belong to the recognition thread in pipeline mode.
+	myo::Arm calibratedArms[maxArmbands];
+};
+
+// The stroke classifier this build recognizes with. Define RECOGNITION_POLICY to build with another one, for example
+// /DRECOGNITION_POLICY=PathLengthClassifier or /DRECOGNITION_POLICY=DtwClassifier.
+#ifndef RECOGNITION_POLICY
+#define RECOGNITION_POLICY AxisPeakClassifier
+#endif
+typedef DataCollector<RECOGNITION_POLICY> Collector;
+
+// Options holds what was asked for on the command line:
+//  --pipeline        run recognition on its own thread; the event callbacks only queue samples
+//  --fast-euler      convert orientation with the polynomial approximations in fast-math.hpp
+//  --record <file>   write every event to a session file (see session-recorder.hpp)
+//  --replay <file>   run a recorded session through the recognizer instead of connecting to a Myo; may be repeated
+//  --event-driven    wait for events instead of polling the Hub at a fixed rate, and render only when the display
+//                    changes (at most --refresh times a second)
+//  --dictionary <f>  suggest words from a dictionary file as letters are entered; waveIn accepts the suggestion
+//  --build-dictionary <words> <f>
+//                    write a dictionary file from a list of "word count" lines and exit
+//  --calibration <f> calibrate the home tolerance and axis weights to each wearer and arm as they type, keeping the
+//                    profiles in a file between sessions
+//  --user <name>     who is wearing the next armband, for --calibration; may be repeated, one per armband in the order
+//                    they pair ("default" if not given)
+//  --filter <stages> filter the orientation before display and recognition, with a comma-separated chain of
+//                    "median" (a median of 5, which removes spikes) and "one-euro" (a 1€ filter, which removes jitter)
+//  --one-euro <min-cutoff> <beta>
+//                    tune the 1€ filter: its cutoff in Hz at rest (1 by default) and how fast it rises with speed (1)
+//  --alphabet [<user>=]<file>
+//                    spell with the alphabet in a file (see alphabet.hpp) instead of the built-in one, for one --user
+//                    or for everyone without their own; may be repeated. Files are reloaded when they change
+//  --dtw-templates [<user>=]<file>
+//                    match strokes against the templates in a file (see DtwTemplateSet::load()) for one --user or for
+//                    everyone without their own; may be repeated. Needs a build with RECOGNITION_POLICY=DtwClassifier
+//  --fusion          end strokes as soon as the gyroscope sees the arm come back and stop, instead of waiting for
+//                    the orientation to settle at home and then pausing for 2 s
+//  --incremental     enter a letter as soon as its strokes can only spell that letter, without waiting for a fist
+//  --telemetry [<address>:]<port>
+//                    publish orientation, poses and letters over UDP to whoever subscribes on this port (see
+//                    telemetry-server.hpp), listening on 127.0.0.1 unless an IPv4 address is given
+//                    (telemetry-client.py subscribes and prints what arrives)
+//  --telemetry-token <token>
+//                    accept only subscribers that send this token; needed to listen on anything but loopback
+//  --rate-limit <burst> <per-minute>
+//                    let each of email and SMS send this many messages at once, and then this many a minute (2 and 6
+//                    by default)
+//  --emg             stream EMG from every Myo and show its level; the features are in Armband::emg
+//  --refresh <hz>    update the status line this many times a second (20 by default)
+//  --power-save      let each Myo lock when it is idle instead of unlocking it again, and while armbands are locked
+//                    or off the arm follow them and update the status line only a few times a second
+//  --service         run unattended: start at once without waiting for a Myo, keep reconnecting to Myo Connect, keep
+//                    each armband's text and calibration when it is unpaired or the connection drops, and never wait
+//                    for console input
+//  --headless        print nothing while running, for unattended use
+//  --latency         measure latency along the path to a delivered message (see latency-probes.hpp) and print the
+//                    histograms on Ctrl+Break (Ctrl+\ outside Windows) and after replays
+struct Options {
+	Options()
+		: pipeline(false),
+		fastEuler(false),
+		incremental(false),
+		fusion(false),
+		emg(false),
+		eventDriven(false),
+		refreshRate(20),
+		powerSave(false),
+		headless(false),
+		service(false),
+		latency(false),
+		telemetryPort(0),
+		telemetryAddress("127.0.0.1"),
+		messageBurst(NotificationDispatcher::defaultBurst),
+		messagesPerMinute(NotificationDispatcher::defaultPerMinute)
+	{
+	}
+
+	bool pipeline;
+	bool fastEuler;
+	bool incremental;
+	bool fusion;
+	bool emg;
+	bool eventDriven;
+	unsigned refreshRate;
+	bool powerSave;
+	bool headless;
+	bool service;
+	bool latency;
+	FilterSettings filtering;
+	unsigned short telemetryPort;
+	std::string telemetryAddress;
+	std::string telemetryToken;
+	unsigned messageBurst;
+	unsigned messagesPerMinute;
+	std::string recordPath;
+	std::vector<std::string> replayPaths;
+	std::string dictionaryPath;
+	std::string calibrationPath;
+	std::vector<std::string> users;
+	std::vector<std::pair<std::string, std::string> > alphabets;
+	std::vector<std::pair<std::string, std::string> > strokeTemplates;
+	std::string wordListPath;
+	std::string buildDictionaryPath;
+};
+
+Options parseOptions(int argc, char** argv)
+{
+	Options options;
+	for (int i = 1; i < argc; ++i) {
+		std::string option = argv[i];
+		if (option == "--pipeline") {
+			options.pipeline = true;
+		}
+		else if (option == "--fast-euler") {
+			options.fastEuler = true;
+		}
+		else if (option == "--dictionary" && i + 1 < argc) {
+			options.dictionaryPath = argv[++i];
+		}
+		else if (option == "--build-dictionary" && i + 2 < argc) {
+			options.wordListPath = argv[++i];
+			options.buildDictionaryPath = argv[++i];
+		}
+		else if (option == "--calibration" && i + 1 < argc) {
+			options.calibrationPath = argv[++i];
+		}
+		else if (option == "--user" && i + 1 < argc) {
+			std::string user = argv[++i];
+			if (user.empty() || user.find_first_of(" \t\r\n") != std::string::npos) {
+				throw std::runtime_error("--user names can't be empty or contain spaces");
+			}
+			options.users.push_back(user);
+		}
+		else if (option == "--filter" && i + 1 < argc) {
+			options.filtering.stageCount = 0;
+			std::string stages = argv[++i];
+			for (size_t start = 0; start <= stages.size();) {
+				size_t end = std::min(stages.find(',', start), stages.size());
+				std::string stage = stages.substr(start, end - start);
+				FilterStage kind;
+				if (stage == "median") {
+					kind = filterMedian;
 				}
-				//check for return to home - add gesture
-				//observe delta
-				if (abs(roll_w - home_roll) > max_roll) {
-					max_roll = abs(roll_w - home_roll);
+				else if (stage == "one-euro") {
+					kind = filterOneEuro;
 				}
-				if (abs(yaw_w - home_yaw) > max_yaw && abs(yaw_w - home_yaw) != 17) {
-					max_yaw = abs(yaw_w - home_yaw);
+				else {
+					throw std::runtime_error("Unknown filter " + stage);
 				}
-				if (abs(pitch_w - home_pitch) > max_pitch) {
-					max_pitch = abs(pitch_w - home_pitch);
+				for (unsigned j = 0; j < options.filtering.stageCount; ++j) {
+					if (options.filtering.stages[j] == kind) {
+						throw std::runtime_error("--filter can use each filter only once");
+					}
 				}
+				options.filtering.stages[options.filtering.stageCount++] = kind;
+				start = end + 1;
 			}
-
+		}
+		else if (option == "--one-euro" && i + 2 < argc) {
+			options.filtering.minCutoff = std::atof(argv[++i]);
+			options.filtering.beta = std::atof(argv[++i]);
+			if (!(options.filtering.minCutoff > 0) || !(options.filtering.beta >= 0)) {
+				throw std::runtime_error("--one-euro needs a positive cutoff and a beta of at least 0");
+			}
+		}
+		else if (option == "--alphabet" && i + 1 < argc) {
+			std::string alphabet = argv[++i];
+			size_t equals = alphabet.find('=');
+			if (equals == std::string::npos) {
+				options.alphabets.push_back(std::make_pair(std::string(), alphabet));
+			}
+			else {
+				options.alphabets.push_back(std::make_pair(alphabet.substr(0, equals), alphabet.substr(equals + 1)));
+			}
+		}
+		else if (option == "--dtw-templates" && i + 1 < argc) {
+			std::string templates = argv[++i];
+			size_t equals = templates.find('=');
+			if (equals == std::string::npos) {
+				options.strokeTemplates.push_back(std::make_pair(std::string(), templates));
+			}
+			else {
+				options.strokeTemplates.push_back(std::make_pair(templates.substr(0, equals),
+					templates.substr(equals + 1)));
+			}
+		}
+		else if (option == "--incremental") {
+			options.incremental = true;
+		}
+		else if (option == "--fusion") {
+			options.fusion = true;
+		}
+		else if (option == "--telemetry" && i + 1 < argc) {
+			std::string endpoint = argv[++i];
+			size_t colon = endpoint.rfind(':');
+			if (colon != std::string::npos) {
+				options.telemetryAddress = endpoint.substr(0, colon);
+			}
+			int port = std::atoi(endpoint.c_str() + (colon == std::string::npos ? 0 : colon + 1));
+			if (port < 1 || port > 65535) {
+				throw std::runtime_error("--telemetry needs a port between 1 and 65535");
+			}
+			options.telemetryPort = static_cast<unsigned short>(port);
+		}
+		else if (option == "--telemetry-token" && i + 1 < argc) {
+			options.telemetryToken = argv[++i];
+		}
+		else if (option == "--rate-limit" && i + 2 < argc) {
+			int burst = std::atoi(argv[++i]);
+			int perMinute = std::atoi(argv[++i]);
+			if (burst < 1 || perMinute < 0) {
+				throw std::runtime_error("--rate-limit needs a burst of at least 1 and a rate of at least 0");
+			}
+			options.messageBurst = static_cast<unsigned>(burst);
+			options.messagesPerMinute = static_cast<unsigned>(perMinute);
+		}
+		else if (option == "--emg") {
+			options.emg = true;
+		}
+		else if (option == "--event-driven") {
+			options.eventDriven = true;
+		}
+		else if (option == "--refresh" && i + 1 < argc) {
+			int rate = std::atoi(argv[++i]);
+			if (rate < 1 || rate > 1000) {
+				throw std::runtime_error("--refresh must be between 1 and 1000");
+			}
+			options.refreshRate = static_cast<unsigned>(rate);
+		}
+		else if (option == "--power-save") {
+			options.powerSave = true;
+		}
+		else if (option == "--headless") {
+			options.headless = true;
+		}
+		else if (option == "--service") {
+			options.service = true;
+		}
+		else if (option == "--latency") {
+			options.latency = true;
+		}
+		else if (option == "--record" && i + 1 < argc) {
+			options.recordPath = argv[++i];
+		}
+		else if (option == "--replay" && i + 1 < argc) {
+			options.replayPaths.push_back(argv[++i]);
 		}
 		else {
-			// Print out a placeholder for the arm and pose when Myo doesn't currently know which arm it's on.
-			std::cout << '[' << std::string(8, ' ') << ']' << "[?]" << '[' << std::string(14, ' ') << ']';
+			throw std::runtime_error("Unknown option " + option);
 		}
+	}
+	return options;
+}
+
+// assignUsers() names the wearer of each armband slot after --user.
+void assignUsers(Collector& collector, const Options& options)
+{
+	for (unsigned i = 0; i < options.users.size() && i < Collector::maxArmbands; ++i) {
+		collector.users[i] = options.users[i];
+	}
+}
+
+// assignStrokeTemplates() hands each armband's classifier its user's templates after --dtw-templates, and throws
+// std::runtime_error if this build's classifier doesn't use templates. Call it after assignUsers().
+void assignStrokeTemplates(Collector& collector, const DtwTemplateLibrary& templates)
+{
+	if (!templates.empty() && !collector.setStrokeTemplates(templates)) {
+		throw std::runtime_error("--dtw-templates needs a build with RECOGNITION_POLICY=DtwClassifier");
+	}
+}
 
-		std::cout << std::flush;
+// replaySession() runs a recorded session through a fresh collector as fast as the CPU allows and prints the text
+// each armband had entered by the end of it. No notifications are sent, since the collector has no backends.
+void replaySession(const std::string& path, const Options& options, const WordDictionary* dictionary,
+	CalibrationStore* calibrations, AlphabetLibrary& alphabets, const DtwTemplateLibrary& templates)
+{
+	SessionReplay replay(path);
+	Collector collector;
+	collector.setDictionary(dictionary);
+	collector.setCalibrationStore(calibrations);
+	collector.commandDevices = false;
+	collector.fastEuler = options.fastEuler;
+	collector.filtering = options.filtering;
+	collector.streamEmg = options.emg;
+	collector.fuseGyroscope = options.fusion;
+	for (unsigned i = 0; i < Collector::maxArmbands; ++i) {
+		collector.recognizers[i].verbose = !options.headless;
+		collector.recognizers[i].incremental = options.incremental;
+		collector.recognizers[i].fusion = options.fusion;
 	}
+	assignUsers(collector, options);
+	collector.setAlphabets(&alphabets);
+	assignStrokeTemplates(collector, templates);
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	replay.run(collector);
+	std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+	collector.saveCalibration();
+
+	std::cout << path << ": " << replay.recordCount() << " events in " << elapsed.count() << " ms" << std::endl;
+	for (unsigned i = 0; i < Collector::maxArmbands; ++i) {
+		if (collector.armbands[i].device) {
+			std::cout << "  armband " << i << ": \"" << collector.textState(i).word << '"' << std::endl;
+		}
+	}
+}
+
+// Set by the signal handler below when the latency histograms should be printed.
+volatile std::sig_atomic_t latencyReportRequested = 0;
 
-	bool epsilonCompare(float var1, float var2, float err)
+void requestLatencyReport(int)
+{
+	latencyReportRequested = 1;
+}
+
+// reportLatencyIfRequested() prints the latency histograms if the signal handler has asked for them.
+void reportLatencyIfRequested()
+{
+	if (latencyReportRequested) {
+		latencyReportRequested = 0;
+		std::cout << std::endl;
+		LatencyProbes::instance().report(std::cout);
+	}
+}
+
+// RenderTimer prints the status line when it expires. The event-driven loop only schedules it after the display has
+// changed, and no sooner than one refresh period after the last frame.
+class RenderTimer : public TimerWheel::Timer {
+public:
+	explicit RenderTimer(Collector& collector)
+		: collector(collector), lastFrame(0)
 	{
-		return !(var2 < var1 - err ||
-			var2 > var1 + err);
 	}
-	// These values are set by onArmSync() and onArmUnsync() above.
-	bool onArm;
-	myo::Arm whichArm;
 
-	// This is set by onUnlocked() and onLocked() above.
-	bool isUnlocked;
+	void expire(uint64_t now)
+	{
+		lastFrame = now;
+		collector.print();
+	}
 
-	// These values are set by onOrientationData() and onPose() above.
-	float roll_w, pitch_w, yaw_w;
-	myo::Pose currentPose;
+	Collector& collector;
+	uint64_t lastFrame;
+};
 
-	float home_roll = -1, home_yaw = -1, home_pitch = -1;
-	float max_roll, max_yaw, max_pitch;
-	std::string gestures = "";
-	std::string word = "";
-		
+// ReportTimer prints the latency histograms when it expires, if the signal handler has asked for them. The
+// event-driven loop only keeps it scheduled with --latency.
+class ReportTimer : public TimerWheel::Timer {
+public:
+	void expire(uint64_t)
+	{
+		reportLatencyIfRequested();
+	}
 };
 
+// ReloadTimer picks up changed alphabet files when it expires. The event-driven loop only keeps it scheduled while
+// alphabets were loaded from files and some armband is awake; a file changed while every armband rests is picked up
+// once one of them wakes.
+class ReloadTimer : public TimerWheel::Timer {
+public:
+	explicit ReloadTimer(Collector& collector)
+		: collector(collector)
+	{
+	}
+
+	void expire(uint64_t)
+	{
+		collector.alphabets->reloadChanged(std::cerr);
+	}
+
+	Collector& collector;
+};
+
+// refreshRate() is how many times a second the main loops should render right now: --refresh, or with --power-save
+// no more than Collector::restingRate while every armband is locked or off the arm.
+unsigned refreshRate(const Collector& collector, const Options& options)
+{
+	if (options.powerSave && collector.allResting()) {
+		return std::min(options.refreshRate, static_cast<unsigned>(Collector::restingRate));
+	}
+	return options.refreshRate;
+}
+
+// runEventDriven() is the main loop for --event-driven. Recognition already happens in the event callbacks, so instead
+// of running the Hub for a fixed slice we return from it as soon as an event arrives or a timer is due. The periodic
+// checks are timers too, scheduled every checkPeriod milliseconds only while they have something to do, so with
+// nothing due, and with every armband locked or off the arm, the loop waits for the next event however long it takes.
+void runEventDriven(myo::Hub& hub, Collector& collector, const Options& options)
+{
+	const uint64_t checkPeriod = 1000;
+	const uint64_t forever = std::numeric_limits<unsigned>::max();
+
+	TimerWheel timers;
+	RenderTimer render(collector);
+	ReportTimer report;
+	ReloadTimer reload(collector);
+	for (;;) {
+		uint64_t now = timerClock();
+		timers.advance(now);
+		uint64_t refreshPeriod = 1000 / refreshRate(collector, options);
+		if (!options.headless && !render.isScheduled() && collector.displayChanged.exchange(false)) {
+			timers.schedule(render, std::max(now, render.lastFrame + refreshPeriod));
+		}
+		if (options.latency && !report.isScheduled()) {
+			timers.schedule(report, now + checkPeriod);
+		}
+		if (collector.alphabets && !reload.isScheduled() && !collector.allResting()) {
+			timers.schedule(reload, now + checkPeriod);
+		}
+
+		uint64_t timeout = timers.timeUntilNext(timerClock(), forever);
+		hub.runOnce(static_cast<unsigned>(std::max<uint64_t>(1, timeout)));
+	}
+}
+
+// runHub() is the main loop. It runs the Hub and keeps the display up to date, and only returns by throwing.
+// runEventDriven() never returns either, so the loop below is the one used without --event-driven.
+void runHub(myo::Hub& hub, Collector& collector, const Options& options)
+{
+	if (options.eventDriven) {
+		runEventDriven(hub, collector, options);
+	}
+	while (1) {
+		// In each iteration of our main loop, we run the Myo event loop for a set number of milliseconds.
+		// We wish to update our display --refresh times a second (20 by default), so we run for 1000/rate
+		// milliseconds. With --power-save the slices get longer while the armbands rest; the events that end the
+		// rest are still handled as they arrive, and the next slice is back to full length.
+		hub.run(1000 / refreshRate(collector, options));
+		// After processing events, we call the print() member function we defined above to print out the values we've
+		// obtained from any events that have occurred.
+		if (!options.headless) {
+			collector.print();
+		}
+		reportLatencyIfRequested();
+		collector.reloadAlphabets();
+	}
+}
+
+// runService() is the main loop for --service. It doesn't wait for a Myo: the collector picks up any Myo paired in
+// Myo Connect as its events arrive. When Myo Connect isn't running, or the Hub fails, it starts over with a new Hub
+// every retryDelay. The collector lives on across Hubs, so every armband keeps its text and calibration, and the
+// Myos of the new Hub adopt their old slots (see Collector::forgetDevices()). It never returns.
+void runService(Collector& collector, const Options& options)
+{
+	const std::chrono::milliseconds retryDelay(250);
+	bool failing = false;
+	for (;;) {
+		try {
+			myo::Hub hub("com.example.hello-myo");
+			hub.addListener(&collector);
+			if (failing) {
+				std::cerr << "Connected to Myo Connect again" << std::endl;
+				failing = false;
+			}
+			runHub(hub, collector, options);
+		}
+		catch (const std::exception& e) {
+			// Only the first failure in a row is reported, so a long outage doesn't flood the log.
+			if (!failing) {
+				std::cerr << "Lost Myo Connect (" << e.what() << "), retrying" << std::endl;
+				failing = true;
+			}
+		}
+		collector.forgetDevices();
+		std::this_thread::sleep_for(retryDelay);
+	}
+}
+
 int main(int argc, char** argv)
 {
+	// Checked before parsing, so that not even a bad command line waits for input when running as a service.
+	bool unattended = std::find(argv + 1, argv + argc, std::string("--service")) != argv + argc;
+
 	// We catch any exceptions that might occur below -- see the catch statement for more details.
 	try {
+		Options options = parseOptions(argc, argv);
+		if (options.latency) {
+			LatencyProbes::instance().enable();
+#ifdef SIGBREAK
+			std::signal(SIGBREAK, requestLatencyReport);
+#else
+			std::signal(SIGQUIT, requestLatencyReport);
+#endif
+		}
+
+		if (!options.buildDictionaryPath.empty()) {
+			buildDictionary(options.wordListPath, options.buildDictionaryPath);
+			return 0;
+		}
+		std::unique_ptr<WordDictionary> dictionary;
+		if (!options.dictionaryPath.empty()) {
+			dictionary.reset(new WordDictionary(options.dictionaryPath));
+		}
 
-		// First, we create a Hub with our application identifier. Be sure not to use the com.example namespace when
+		AlphabetLibrary alphabets;
+		for (size_t i = 0; i < options.alphabets.size(); ++i) {
+			alphabets.load(options.alphabets[i].first, options.alphabets[i].second);
+		}
+		DtwTemplateLibrary templates;
+		for (size_t i = 0; i < options.strokeTemplates.size(); ++i) {
+			templates.load(options.strokeTemplates[i].first, options.strokeTemplates[i].second);
+		}
+
+		std::unique_ptr<CalibrationStore> calibrations;
+		if (!options.calibrationPath.empty()) {
+			calibrations.reset(new CalibrationStore(options.calibrationPath));
+		}
+
+		// Replaying recorded sessions needs neither a Hub nor a Myo.
+		if (!options.replayPaths.empty()) {
+			for (size_t i = 0; i < options.replayPaths.size(); ++i) {
+				replaySession(options.replayPaths[i], options, dictionary.get(), calibrations.get(), alphabets,
+					templates);
+			}
+			if (options.latency) {
+				LatencyProbes::instance().report(std::cout);
+			}
+			return 0;
+		}
+
+		// First we construct an instance of our DeviceListener, so that we can register it with the Hub.
+		Collector collector;
+
+		// Messages are delivered directly over HTTPS when the provider credentials are set in the environment (see
+		// https-backends.hpp), and otherwise by the helper scripts in the executable's own directory, so that a service
+		// started from anywhere still finds them.
+		std::unique_ptr<NotificationBackend> email, sms;
+#ifdef _WIN32
+		email = SendGridBackend::fromEnvironment();
+		sms = TwilioBackend::fromEnvironment();
+#endif
+		if (!email) {
+			email.reset(new ScriptBackend(besideExecutable("testgrid.py")));
+		}
+		if (!sms) {
+			sms.reset(new ScriptBackend(besideExecutable("testtwil.py")));
+		}
+		collector.notifier.setBackend(channelEmail, std::move(email));
+		collector.notifier.setBackend(channelSms, std::move(sms));
+		for (unsigned channel = 0; channel < channelCount; ++channel) {
+			collector.notifier.setRateLimit(static_cast<NotificationChannel>(channel), options.messageBurst,
+				options.messagesPerMinute);
+		}
+
+		collector.fastEuler = options.fastEuler;
+		collector.filtering = options.filtering;
+		collector.streamEmg = options.emg;
+		collector.fuseGyroscope = options.fusion;
+		collector.keepUnpaired = options.service;
+		collector.powerSaving = options.powerSave;
+		collector.setDictionary(dictionary.get());
+		collector.setCalibrationStore(calibrations.get());
+		assignUsers(collector, options);
+		collector.setAlphabets(&alphabets);
+		assignStrokeTemplates(collector, templates);
+		for (unsigned i = 0; i < Collector::maxArmbands; ++i) {
+			collector.recognizers[i].verbose = !options.headless;
+			collector.recognizers[i].incremental = options.incremental;
+			collector.recognizers[i].fusion = options.fusion;
+		}
+		if (options.pipeline) {
+			collector.startPipeline();
+		}
+		std::unique_ptr<SessionRecorder> recorder;
+		if (!options.recordPath.empty()) {
+			recorder.reset(new SessionRecorder(options.recordPath));
+			collector.recorder = recorder.get();
+		}
+		std::unique_ptr<TelemetryServer> telemetry;
+		if (options.telemetryPort) {
+			telemetry.reset(new TelemetryServer(options.telemetryAddress, options.telemetryPort,
+				options.telemetryToken));
+			collector.telemetry = telemetry.get();
+		}
+
+		// A service doesn't wait for anything before running, see runService().
+		if (options.service) {
+			runService(collector, options);
+		}
+
+		// Next, we create a Hub with our application identifier. Be sure not to use the com.example namespace when
 		// publishing your application. The Hub provides access to one or more Myos.
 		myo::Hub hub("com.example.hello-myo");
 
@@ -264,33 +1603,27 @@ int main(int argc, char** argv)
 			throw std::runtime_error("Unable to find a Myo!");
 		}
 
-		// We've found a Myo.
+		// We've found a Myo. Any further Myos paired in Myo Connect are picked up by the collector as their events
+		// arrive.
 		std::cout << "Connected to a Myo armband!" << std::endl << std::endl;
-
-		// Next we construct an instance of our DeviceListener, so that we can register it with the Hub.
-		DataCollector collector;
+		collector.enableEmg(myo);
 
 		// Hub::addListener() takes the address of any object whose class inherits from DeviceListener, and will cause
 		// Hub::run() to send events to all registered device listeners.
 		hub.addListener(&collector);
 
-		// Finally we enter our main loop.
-		while (1) {
-			// In each iteration of our main loop, we run the Myo event loop for a set number of milliseconds.
-			// In this case, we wish to update our display 20 times a second, so we run for 1000/20 milliseconds.
-			hub.run(1000 / 20);
-			// After processing events, we call the print() member function we defined above to print out the values we've
-			// obtained from any events that have occurred.
-			collector.print();
-
-		}
+		// Finally we enter our main loop, which never returns.
+		runHub(hub, collector, options);
 
-		// If a standard exception occurred, we print out its message and exit.
+		// If a standard exception occurred, we print out its message and exit. Unattended, nobody is there to press
+		// enter.
 	}
 	catch (const std::exception& e) {
 		std::cerr << "Error: " << e.what() << std::endl;
-		std::cerr << "Press enter to continue.";
-		std::cin.ignore();
+		if (!unattended) {
+			std::cerr << "Press enter to continue.";
+			std::cin.ignore();
+		}
 		return 1;
 	}
 }
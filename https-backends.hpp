@@ -0,0 +1,244 @@
+// Notification backends that talk to SendGrid and Twilio directly over HTTPS, reusing one keep-alive connection per
+// provider instead of starting a Python interpreter (and a fresh TLS handshake) for every message.
+#pragma once
+
+#ifdef _WIN32
+
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+// Leaves out the old winsock.h, which would clash with the winsock2.h telemetry-server.hpp needs.
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#include <winhttp.h>
+
+#include <cctype>
+#include <memory>
+#include <stdexcept>
+#include <stdlib.h>
+#include <string>
+
+#include "notifier.hpp"
+
+// HttpsConnection holds a WinHTTP session and a connection handle for one host. WinHTTP pools the underlying TLS
+// connections per session, so requests made through the same HttpsConnection reuse the socket and skip the handshake
+// as long as the server keeps it alive.
+class HttpsConnection {
+public:
+	explicit HttpsConnection(const std::wstring& host)
+		: session(WinHttpOpen(L"hello-myo/1.0", WINHTTP_ACCESS_TYPE_DEFAULT_PROXY, WINHTTP_NO_PROXY_NAME,
+			WINHTTP_NO_PROXY_BYPASS, 0)),
+		connection(session ? WinHttpConnect(session, host.c_str(), INTERNET_DEFAULT_HTTPS_PORT, 0) : NULL)
+	{
+		if (!connection) {
+			if (session) {
+				WinHttpCloseHandle(session);
+			}
+			throw std::runtime_error("Unable to open an HTTPS session");
+		}
+	}
+
+	~HttpsConnection()
+	{
+		WinHttpCloseHandle(connection);
+		WinHttpCloseHandle(session);
+	}
+
+	// post() sends a POST request and returns the HTTP status code, or 0 if the request failed. The response body is
+	// always read to the end, otherwise WinHTTP can't return the connection to its keep-alive pool.
+	DWORD post(const std::wstring& path, const std::wstring& headers, const std::string& body)
+	{
+		HINTERNET request = WinHttpOpenRequest(connection, L"POST", path.c_str(), NULL, WINHTTP_NO_REFERER,
+			WINHTTP_DEFAULT_ACCEPT_TYPES, WINHTTP_FLAG_SECURE);
+		if (!request) {
+			return 0;
+		}
+
+		DWORD status = 0;
+		if (WinHttpSendRequest(request, headers.c_str(), static_cast<DWORD>(headers.size()),
+				const_cast<char*>(body.data()), static_cast<DWORD>(body.size()), static_cast<DWORD>(body.size()), 0)
+			&& WinHttpReceiveResponse(request, NULL)) {
+			DWORD size = sizeof(status);
+			WinHttpQueryHeaders(request, WINHTTP_QUERY_STATUS_CODE | WINHTTP_QUERY_FLAG_NUMBER,
+				WINHTTP_HEADER_NAME_BY_INDEX, &status, &size, WINHTTP_NO_HEADER_INDEX);
+
+			char buffer[1024];
+			DWORD read = 0;
+			while (WinHttpReadData(request, buffer, sizeof(buffer), &read) && read > 0) {
+			}
+		}
+
+		WinHttpCloseHandle(request);
+		return status;
+	}
+
+private:
+	HttpsConnection(const HttpsConnection&);
+	HttpsConnection& operator=(const HttpsConnection&);
+
+	HINTERNET session;
+	HINTERNET connection;
+};
+
+namespace https {
+
+// Provider credentials and addresses are taken from the environment so that they stay out of the source tree.
+inline std::string environment(const char* name)
+{
+	const char* value = getenv(name);
+	return value ? value : "";
+}
+
+inline std::wstring widen(const std::string& text)
+{
+	return std::wstring(text.begin(), text.end());
+}
+
+inline std::string jsonEscape(const std::string& text)
+{
+	static const char hex[] = "0123456789abcdef";
+	std::string escaped;
+	for (std::string::const_iterator c = text.begin(); c != text.end(); ++c) {
+		unsigned char ch = static_cast<unsigned char>(*c);
+		if (ch == '"' || ch == '\\') {
+			escaped += '\\';
+			escaped += *c;
+		}
+		else if (ch < 0x20) {
+			escaped += "\\u00";
+			escaped += hex[ch >> 4];
+			escaped += hex[ch & 0xf];
+		}
+		else {
+			escaped += *c;
+		}
+	}
+	return escaped;
+}
+
+inline std::string formEscape(const std::string& text)
+{
+	static const char hex[] = "0123456789ABCDEF";
+	std::string escaped;
+	for (std::string::const_iterator c = text.begin(); c != text.end(); ++c) {
+		unsigned char ch = static_cast<unsigned char>(*c);
+		if (isalnum(ch) || ch == '-' || ch == '_' || ch == '.' || ch == '~') {
+			escaped += *c;
+		}
+		else if (ch == ' ') {
+			escaped += '+';
+		}
+		else {
+			escaped += '%';
+			escaped += hex[ch >> 4];
+			escaped += hex[ch & 0xf];
+		}
+	}
+	return escaped;
+}
+
+inline std::string base64(const std::string& data)
+{
+	static const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+	std::string encoded;
+	for (std::string::size_type i = 0; i < data.size(); i += 3) {
+		unsigned value = static_cast<unsigned char>(data[i]) << 16;
+		if (i + 1 < data.size()) {
+			value |= static_cast<unsigned char>(data[i + 1]) << 8;
+		}
+		if (i + 2 < data.size()) {
+			value |= static_cast<unsigned char>(data[i + 2]);
+		}
+		encoded += alphabet[(value >> 18) & 0x3f];
+		encoded += alphabet[(value >> 12) & 0x3f];
+		encoded += i + 1 < data.size() ? alphabet[(value >> 6) & 0x3f] : '=';
+		encoded += i + 2 < data.size() ? alphabet[value & 0x3f] : '=';
+	}
+	return encoded;
+}
+
+} // namespace https
+
+// SendGridBackend sends the message as a plain text email through the SendGrid v3 mail API.
+class SendGridBackend : public NotificationBackend {
+public:
+	SendGridBackend(const std::string& apiKey, const std::string& from, const std::string& to)
+		: connection(L"api.sendgrid.com"),
+		headers(https::widen("Authorization: Bearer " + apiKey + "\r\nContent-Type: application/json")),
+		from(from), to(to)
+	{
+	}
+
+	bool send(const char* text)
+	{
+		std::string body = "{\"personalizations\":[{\"to\":[{\"email\":\"" + https::jsonEscape(to) + "\"}]}],"
+			"\"from\":{\"email\":\"" + https::jsonEscape(from) + "\"},\"subject\":\"Example\","
+			"\"content\":[{\"type\":\"text/plain\",\"value\":\"" + https::jsonEscape(text) + "\"}]}";
+		DWORD status = connection.post(L"/v3/mail/send", headers, body);
+		return status >= 200 && status < 300;
+	}
+
+	// fromEnvironment() returns a backend configured from SENDGRID_API_KEY, SENDGRID_FROM and SENDGRID_TO, or null if
+	// any of them is missing.
+	static std::unique_ptr<NotificationBackend> fromEnvironment()
+	{
+		std::string apiKey = https::environment("SENDGRID_API_KEY");
+		std::string from = https::environment("SENDGRID_FROM");
+		std::string to = https::environment("SENDGRID_TO");
+		if (apiKey.empty() || from.empty() || to.empty()) {
+			return std::unique_ptr<NotificationBackend>();
+		}
+		return std::unique_ptr<NotificationBackend>(new SendGridBackend(apiKey, from, to));
+	}
+
+private:
+	HttpsConnection connection;
+	std::wstring headers;
+	std::string from, to;
+};
+
+// TwilioBackend sends the message as an SMS through the Twilio Messages API.
+class TwilioBackend : public NotificationBackend {
+public:
+	TwilioBackend(const std::string& accountSid, const std::string& authToken, const std::string& from,
+		const std::string& to)
+		: connection(L"api.twilio.com"),
+		path(https::widen("/2010-04-01/Accounts/" + accountSid + "/Messages.json")),
+		headers(https::widen("Authorization: Basic " + https::base64(accountSid + ":" + authToken)
+			+ "\r\nContent-Type: application/x-www-form-urlencoded")),
+		from(from), to(to)
+	{
+	}
+
+	bool send(const char* text)
+	{
+		std::string body = "Body=" + https::formEscape(text) + "&From=" + https::formEscape(from)
+			+ "&To=" + https::formEscape(to);
+		DWORD status = connection.post(path, headers, body);
+		return status >= 200 && status < 300;
+	}
+
+	// fromEnvironment() returns a backend configured from TWILIO_ACCOUNT_SID, TWILIO_AUTH_TOKEN, TWILIO_FROM and
+	// TWILIO_TO, or null if any of them is missing.
+	static std::unique_ptr<NotificationBackend> fromEnvironment()
+	{
+		std::string accountSid = https::environment("TWILIO_ACCOUNT_SID");
+		std::string authToken = https::environment("TWILIO_AUTH_TOKEN");
+		std::string from = https::environment("TWILIO_FROM");
+		std::string to = https::environment("TWILIO_TO");
+		if (accountSid.empty() || authToken.empty() || from.empty() || to.empty()) {
+			return std::unique_ptr<NotificationBackend>();
+		}
+		return std::unique_ptr<NotificationBackend>(new TwilioBackend(accountSid, authToken, from, to));
+	}
+
+private:
+	HttpsConnection connection;
+	std::wstring path;
+	std::wstring headers;
+	std::string from, to;
+};
+
+#endif // _WIN32
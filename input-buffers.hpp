@@ -0,0 +1,110 @@
+// Fixed-capacity buffers for the strokes and letters being entered, so the input path never touches the heap.
+#pragma once
+
+#include "letter-table.hpp"
+
+// StrokeBuffer holds the strokes entered since the last letter in a ring of Capacity entries. When it is full the oldest
+// stroke is overwritten, so the buffer always holds the most recent strokes.
+template<unsigned Capacity>
+class StrokeBuffer {
+public:
+	StrokeBuffer()
+		: head(0), count(0)
+	{
+	}
+
+	void push(Stroke stroke)
+	{
+		strokes[(head + count) % Capacity] = stroke;
+		if (count < Capacity) {
+			++count;
+		}
+		else {
+			head = (head + 1) % Capacity;
+		}
+	}
+
+	void clear()
+	{
+		head = 0;
+		count = 0;
+	}
+
+	unsigned size() const
+	{
+		return count;
+	}
+
+	// operator[] returns the i-th oldest stroke in the buffer.
+	Stroke operator[](unsigned i) const
+	{
+		return strokes[(head + i) % Capacity];
+	}
+
+	// code() encodes the buffered strokes as a gesture code, to look up in an AlphabetIndex.
+	unsigned code() const
+	{
+		unsigned result = 0;
+		for (unsigned i = 0; i < count; ++i) {
+			result = appendStroke(result, (*this)[i]);
+		}
+		return result;
+	}
+
+private:
+	Stroke strokes[Capacity];
+	unsigned head, count;
+};
+
+// WordBuffer holds the text entered so far as a null-terminated string of at most Capacity characters. Letters that
+// don't fit are rejected rather than dropping what was already typed.
+template<unsigned Capacity>
+class WordBuffer {
+public:
+	WordBuffer()
+		: length(0)
+	{
+		text[0] = '\0';
+	}
+
+	// append() adds a letter to the end of the word. It returns false if the word is already full.
+	bool append(char letter)
+	{
+		if (length == Capacity) {
+			return false;
+		}
+		text[length++] = letter;
+		text[length] = '\0';
+		return true;
+	}
+
+	// backspace() removes the last letter. It returns false if the word is already empty.
+	bool backspace()
+	{
+		if (length == 0) {
+			return false;
+		}
+		text[--length] = '\0';
+		return true;
+	}
+
+	void clear()
+	{
+		length = 0;
+		text[0] = '\0';
+	}
+
+	unsigned size() const
+	{
+		return length;
+	}
+
+	const char* c_str() const
+	{
+		return text;
+	}
+
+private:
+	char text[Capacity + 1];
+	unsigned length;
+};
@@ -0,0 +1,274 @@
+// Low-overhead latency probes for the path from a Myo event to a delivered message.
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <iomanip>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <ostream>
+#include <stdint.h>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "spsc-queue.hpp"
+
+// The intervals that are measured. Each probe records when one of them began and ended.
+enum LatencySpan {
+	// From the SDK event timestamp to the event callback, relative to the quickest event seen from the same armband.
+	// This is how long events wait in the SDK, for example while the main loop is printing instead of running the Hub.
+	spanEventDelay,
+	// From the callback for the sample on which the arm came back home to the stroke being recorded.
+	spanHomeReached,
+	// From the callback for the fist to its letter being appended to the word.
+	spanLetterDecoded,
+	// From the callback for fingersSpread or waveOut to the message being queued for delivery.
+	spanMessagePosted,
+	// From the message being queued to the dispatcher starting to send it.
+	spanDispatchWait,
+	// From the dispatcher starting to send a message to the backend returning.
+	spanSend,
+	spanCount
+};
+
+// probeClock() returns the time in nanoseconds on the clock all probes use.
+inline int64_t probeClock()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// LatencyHistogram counts durations in buckets whose width grows with the duration, so that it covers nanoseconds
+// to hours in a fixed array with at most 12.5% error. Durations below 16 ns get a bucket each; above that every power
+// of two is split into eight buckets.
+class LatencyHistogram {
+public:
+	static const unsigned bucketCount = 16 + 60 * 8;
+
+	LatencyHistogram()
+		: count(0), maximum(0)
+	{
+		for (unsigned i = 0; i < bucketCount; ++i) {
+			buckets[i] = 0;
+		}
+	}
+
+	void add(uint64_t duration)
+	{
+		++buckets[bucketFor(duration)];
+		++count;
+		if (duration > maximum) {
+			maximum = duration;
+		}
+	}
+
+	// percentile() returns the lower bound of the bucket holding the given percentile, or 0 if nothing was added.
+	uint64_t percentile(double percent) const
+	{
+		uint64_t rank = static_cast<uint64_t>(percent / 100 * count);
+		uint64_t seen = 0;
+		for (unsigned i = 0; i < bucketCount; ++i) {
+			seen += buckets[i];
+			if (seen > rank) {
+				return lowerBound(i);
+			}
+		}
+		return maximum;
+	}
+
+	uint64_t count;
+	uint64_t maximum;
+
+private:
+	static unsigned bucketFor(uint64_t duration)
+	{
+		if (duration < 16) {
+			return static_cast<unsigned>(duration);
+		}
+		unsigned exponent = 63;
+		while (!(duration >> exponent)) {
+			--exponent;
+		}
+		return 16 + (exponent - 4) * 8 + static_cast<unsigned>((duration >> (exponent - 3)) & 7);
+	}
+
+	static uint64_t lowerBound(unsigned bucket)
+	{
+		if (bucket < 16) {
+			return bucket;
+		}
+		unsigned exponent = (bucket - 16) / 8 + 4;
+		return (8 + uint64_t((bucket - 16) % 8)) << (exponent - 3);
+	}
+
+	uint64_t buckets[bucketCount];
+};
+
+// LatencyProbes collects probe records from every thread into one histogram per span. record() only appends to a
+// ring owned by the calling thread, so the threads being measured never contend with each other or take a lock; a
+// background thread drains the rings into the histograms. Probes cost a single branch until enable() is called.
+class LatencyProbes {
+public:
+	static const unsigned ringCapacity = 8192;
+
+	static LatencyProbes& instance()
+	{
+		static LatencyProbes probes;
+		return probes;
+	}
+
+	~LatencyProbes()
+	{
+		if (flusher.joinable()) {
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				stopping = true;
+			}
+			wake.notify_one();
+			flusher.join();
+		}
+		for (size_t i = 0; i < rings.size(); ++i) {
+			rings[i]->~ProbeRing();
+		}
+	}
+
+	// enable() starts collecting. Probes recorded before it are ignored.
+	void enable()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (!flusher.joinable()) {
+			flusher = std::thread(&LatencyProbes::run, this);
+		}
+		enabled = true;
+	}
+
+	bool isEnabled() const
+	{
+		return enabled.load(std::memory_order_relaxed);
+	}
+
+	// record() notes that a span began and ended at the given probeClock() times. `source` tells apart the armbands or
+	// channels a span is measured for. If the calling thread's ring is full the record is dropped and counted.
+	void record(LatencySpan span, unsigned source, int64_t begin, int64_t end)
+	{
+		if (!isEnabled()) {
+			return;
+		}
+		ProbeRecord probe;
+		probe.begin = begin;
+		probe.end = end;
+		probe.span = static_cast<uint8_t>(span);
+		probe.source = static_cast<uint8_t>(source);
+		if (!ring().push(probe)) {
+			++dropped;
+		}
+	}
+
+	// report() prints the histograms, including everything recorded up to the call.
+	void report(std::ostream& out)
+	{
+		static const char* const spanNames[spanCount] = {
+			"event delay", "home reached", "letter decoded", "message posted", "dispatch wait", "send"
+		};
+
+		std::lock_guard<std::mutex> lock(mutex);
+		flush();
+		out << "latency (us)          count       p50       p90       p99       max\n" << std::fixed << std::setprecision(1);
+		for (unsigned i = 0; i < spanCount; ++i) {
+			const LatencyHistogram& histogram = histograms[i];
+			out << std::left << std::setw(16) << spanNames[i] << std::right << std::setw(11) << histogram.count
+				<< std::setw(10) << histogram.percentile(50) / 1000.0 << std::setw(10) << histogram.percentile(90) / 1000.0
+				<< std::setw(10) << histogram.percentile(99) / 1000.0 << std::setw(10) << histogram.maximum / 1000.0
+				<< '\n';
+		}
+		if (dropped) {
+			out << dropped.load() << " probes dropped\n";
+		}
+		out << std::flush;
+	}
+
+private:
+	struct ProbeRecord {
+		int64_t begin, end;
+		uint8_t span;
+		uint8_t source;
+	};
+
+	typedef SpscQueue<ProbeRecord, ringCapacity> ProbeRing;
+
+	LatencyProbes()
+		: enabled(false), dropped(0), stopping(false)
+	{
+		for (unsigned i = 0; i < 256; ++i) {
+			quickestEvent[i] = std::numeric_limits<int64_t>::max();
+		}
+	}
+
+	// ring() returns the calling thread's ring, creating it on first use. Rings are kept until exit, so records left
+	// by a thread that has finished are still drained. They are placed by hand because plain new doesn't honour the
+	// cache line alignment SpscQueue asks for before C++17.
+	ProbeRing& ring()
+	{
+		static thread_local ProbeRing* threadRing = 0;
+		if (!threadRing) {
+			std::lock_guard<std::mutex> lock(mutex);
+			std::unique_ptr<char[]> memory(new char[sizeof(ProbeRing) + alignof(ProbeRing)]);
+			uintptr_t address = reinterpret_cast<uintptr_t>(memory.get());
+			address = (address + alignof(ProbeRing) - 1) & ~uintptr_t(alignof(ProbeRing) - 1);
+			threadRing = new (reinterpret_cast<void*>(address)) ProbeRing();
+			ringMemory.push_back(std::move(memory));
+			rings.push_back(threadRing);
+		}
+		return *threadRing;
+	}
+
+	// flush() moves every queued record into the histograms. The caller must hold the mutex, which makes the flusher
+	// thread and report() take turns as the consumer of each ring.
+	void flush()
+	{
+		ProbeRecord probe;
+		for (size_t i = 0; i < rings.size(); ++i) {
+			while (rings[i]->pop(probe)) {
+				int64_t duration = probe.end - probe.begin;
+				if (probe.span == spanEventDelay) {
+					// Event timestamps come from a different clock, so only the delay beyond the quickest event is
+					// meaningful.
+					int64_t& quickest = quickestEvent[probe.source];
+					if (duration < quickest) {
+						quickest = duration;
+					}
+					duration -= quickest;
+				}
+				histograms[probe.span].add(duration > 0 ? static_cast<uint64_t>(duration) : 0);
+			}
+		}
+	}
+
+	// run() is the body of the flusher thread. It drains the rings often enough that they don't fill up at the rate
+	// events arrive.
+	void run()
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		while (!stopping) {
+			wake.wait_for(lock, std::chrono::milliseconds(20));
+			flush();
+		}
+	}
+
+	std::atomic<bool> enabled;
+	std::atomic<unsigned long long> dropped;
+
+	std::vector<std::unique_ptr<char[]>> ringMemory;
+	std::vector<ProbeRing*> rings;
+	LatencyHistogram histograms[spanCount];
+	int64_t quickestEvent[256];
+
+	bool stopping;
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::thread flusher;
+};
@@ -0,0 +1,141 @@
+// The gesture encoding and the built-in gesture vocabulary, checked at compile time.
+#pragma once
+
+#include <stdint.h>
+
+// Each stroke of a gesture is classified by the axis that moved the furthest away from the home position, and by the
+// way it moved: towards higher values on the orientation scale, or with strokeNegative set, towards lower ones.
+enum Stroke {
+	strokeNone = 0,
+	strokeRoll = 1,
+	strokePitch = 2,
+	strokeYaw = 3,
+	strokeNegative = 4,
+	strokeRollNegative = strokeRoll | strokeNegative,
+	strokePitchNegative = strokePitch | strokeNegative,
+	strokeYawNegative = strokeYaw | strokeNegative
+};
+
+// The names strokes have in alphabet and template files, indexed by Stroke.
+const char* const strokeNames[] = { "", "roll+", "pitch+", "yaw+", "", "roll-", "pitch-", "yaw-" };
+
+// strokeAxis() returns the axis of a stroke, whichever way it went.
+constexpr Stroke strokeAxis(Stroke stroke)
+{
+	return static_cast<Stroke>(stroke & ~strokeNegative);
+}
+
+// directedStroke() returns the stroke about `axis` that went the way of `offset`, an offset from home.
+constexpr Stroke directedStroke(Stroke axis, float offset)
+{
+	return offset < 0 ? static_cast<Stroke>(axis | strokeNegative) : axis;
+}
+
+// A gesture is encoded as its sequence of strokes, three bits per stroke (one octal digit) with the first stroke in
+// the most significant position. No stroke encodes as zero, so sequences of different lengths never share a code.
+const unsigned strokeBits = 3;
+const unsigned maxGestureStrokes = 4;
+const unsigned gestureCodeCount = 1u << (strokeBits * maxGestureStrokes);
+
+// The bits of a code that hold the strokes' axes, and the ones that hold their directions.
+const unsigned gestureAxisBits = 03333;
+const unsigned gestureDirectionBits = 04444;
+
+// appendStroke() returns the code of the gesture that continues the gesture `code` with one more stroke.
+constexpr unsigned appendStroke(unsigned code, Stroke stroke)
+{
+	return (code << strokeBits) | stroke;
+}
+
+// directionBitsOf() returns the direction bits of every stroke in `code`, set or not.
+constexpr unsigned directionBitsOf(unsigned code)
+{
+	return code == 0 ? 0 : (directionBitsOf(code >> strokeBits) << strokeBits) | strokeNegative;
+}
+
+constexpr unsigned strokesFrom(unsigned code)
+{
+	return code;
+}
+
+template<typename... Rest>
+constexpr unsigned strokesFrom(unsigned code, Stroke first, Rest... rest)
+{
+	return strokesFrom(appendStroke(code, first), rest...);
+}
+
+// strokes() encodes a sequence of strokes, e.g. strokes(strokePitch, strokeYaw) for pitch followed by yaw.
+template<typename... Strokes>
+constexpr unsigned strokes(Strokes... sequence)
+{
+	return strokesFrom(0, sequence...);
+}
+
+// A letter is spelled either by the axes of its strokes alone, whichever way each went, or, with `directed`, by
+// their directions too.
+struct LetterEntry {
+	unsigned code;
+	char letter;
+	bool directed;
+};
+
+// The gesture vocabulary. To add a letter, add an entry here; the checks below reject codes that are out of range or
+// that overlap: an undirected letter takes its axes in every direction. The letters from l on are told apart by
+// direction. Their axes spell no undirected letter, and are never the start of only one, so that incremental decoding
+// still enters those as early as it did without them.
+constexpr LetterEntry letterEntries[] = {
+	{ strokes(), ' ' },
+	{ strokes(strokePitch, strokeYaw, strokePitch), 'a' },
+	{ strokes(strokeRoll, strokeYaw), 'b' },
+	{ strokes(strokeRoll), 'c' },
+	{ strokes(strokeRoll, strokePitch), 'd' },
+	{ strokes(strokeRoll, strokeYaw, strokePitch), 'e' },
+	{ strokes(strokePitch, strokePitch, strokeYaw), 'f' },
+	{ strokes(strokeRoll, strokePitch, strokeYaw), 'g' },
+	{ strokes(strokePitch, strokeRoll), 'h' },
+	{ strokes(strokeYaw, strokePitch, strokeYaw), 'i' },
+	{ strokes(strokeYaw, strokePitch, strokeRoll), 'j' },
+	{ strokes(strokePitch, strokeYaw, strokeYaw), 'k' },
+	{ strokes(strokePitch), 'l', true },
+	{ strokes(strokePitchNegative), 'm', true },
+	{ strokes(strokeYaw), 'n', true },
+	{ strokes(strokeYawNegative), 'o', true },
+	{ strokes(strokeRoll, strokeRoll), 'p', true },
+	{ strokes(strokeRollNegative, strokeRollNegative), 'q', true },
+	{ strokes(strokeRoll, strokeRollNegative), 'r', true },
+	{ strokes(strokeRollNegative, strokeRoll), 's', true },
+	{ strokes(strokeYaw, strokeYaw), 't', true },
+	{ strokes(strokeYawNegative, strokeYawNegative), 'u', true },
+	{ strokes(strokeYaw, strokeYawNegative), 'v', true },
+	{ strokes(strokeYawNegative, strokeYaw), 'w', true },
+	{ strokes(strokeYaw, strokeRoll), 'x', true },
+	{ strokes(strokeYawNegative, strokeRollNegative), 'y', true },
+	{ strokes(strokeYaw, strokeRollNegative), 'z', true },
+};
+const unsigned letterEntryCount = sizeof(letterEntries) / sizeof(letterEntries[0]);
+
+constexpr bool entriesOverlap(const LetterEntry& first, const LetterEntry& second)
+{
+	return first.directed && second.directed ? first.code == second.code
+		: (first.code & gestureAxisBits) == (second.code & gestureAxisBits);
+}
+
+constexpr bool codeTakenAfter(unsigned i, unsigned j)
+{
+	return j < letterEntryCount && (entriesOverlap(letterEntries[j], letterEntries[i]) || codeTakenAfter(i, j + 1));
+}
+
+constexpr bool codesAreValid(unsigned i = 0)
+{
+	return i >= letterEntryCount
+		|| (letterEntries[i].code < gestureCodeCount && !codeTakenAfter(i, i + 1) && codesAreValid(i + 1));
+}
+
+static_assert(codesAreValid(), "every letter needs a distinct gesture of at most maxGestureStrokes strokes");
+
+// Incremental decoding looks at the gesture entered so far as a prefix of the codes in an alphabet. hasPrefix() is
+// true if `code` starts with the strokes of `prefix`; every code starts with the empty gesture.
+constexpr bool hasPrefix(unsigned code, unsigned prefix)
+{
+	return code == prefix || (code > prefix && hasPrefix(code >> strokeBits, prefix));
+}
@@ -0,0 +1,113 @@
+// Read-only memory mapping of a whole file.
+#pragma once
+
+#include <cstddef>
+#include <stdexcept>
+#include <string>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+// Leaves out the old winsock.h, which would clash with the winsock2.h telemetry-server.hpp needs.
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// MappedFile maps a file into memory for reading, so that large recordings can be walked without copying them. The
+// constructor throws std::runtime_error if the file can't be opened or mapped.
+class MappedFile {
+public:
+	explicit MappedFile(const std::string& path)
+		: view(0), length(0)
+	{
+#ifdef _WIN32
+		mapping = NULL;
+		file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+		if (file == INVALID_HANDLE_VALUE) {
+			throw std::runtime_error("Unable to open " + path);
+		}
+		LARGE_INTEGER size;
+		if (!GetFileSizeEx(file, &size)) {
+			CloseHandle(file);
+			throw std::runtime_error("Unable to read the size of " + path);
+		}
+		length = static_cast<size_t>(size.QuadPart);
+		if (length > 0) {
+			mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+			view = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : NULL;
+			if (!view) {
+				if (mapping) {
+					CloseHandle(mapping);
+				}
+				CloseHandle(file);
+				throw std::runtime_error("Unable to map " + path);
+			}
+		}
+#else
+		descriptor = open(path.c_str(), O_RDONLY);
+		if (descriptor < 0) {
+			throw std::runtime_error("Unable to open " + path);
+		}
+		struct stat info;
+		if (fstat(descriptor, &info) != 0) {
+			close(descriptor);
+			throw std::runtime_error("Unable to read the size of " + path);
+		}
+		length = static_cast<size_t>(info.st_size);
+		if (length > 0) {
+			view = mmap(0, length, PROT_READ, MAP_PRIVATE, descriptor, 0);
+			if (view == MAP_FAILED) {
+				close(descriptor);
+				throw std::runtime_error("Unable to map " + path);
+			}
+		}
+#endif
+	}
+
+	~MappedFile()
+	{
+#ifdef _WIN32
+		if (view) {
+			UnmapViewOfFile(view);
+			CloseHandle(mapping);
+		}
+		CloseHandle(file);
+#else
+		if (view) {
+			munmap(view, length);
+		}
+		close(descriptor);
+#endif
+	}
+
+	const unsigned char* data() const
+	{
+		return static_cast<const unsigned char*>(view);
+	}
+
+	size_t size() const
+	{
+		return length;
+	}
+
+private:
+	MappedFile(const MappedFile&);
+	MappedFile& operator=(const MappedFile&);
+
+#ifdef _WIN32
+	HANDLE file;
+	HANDLE mapping;
+#else
+	int descriptor;
+#endif
+	void* view;
+	size_t length;
+};
@@ -0,0 +1,105 @@
+// Stroke segmentation from the gyroscope, which sees a stroke end as soon as the arm stops rather than once it has
+// settled back home.
+#pragma once
+
+#include <cmath>
+#include <stdint.h>
+
+// MotionSegmenter follows the angular velocity of the arm, in degrees per second as the Myo's gyroscope reports it,
+// and tells when a stroke starts and ends. A stroke starts when the arm turns faster than startSpeed. It goes out and
+// comes back, so the velocity about the axis it turns about most crosses zero at its far end; it ends once that
+// happened and the arm has then been slower than stopSpeed for settleDuration. Pausing at the far end of a stroke
+// therefore doesn't end it. A stroke that never comes back ends after maxStrokeDuration. Timestamps are the SDK event
+// timestamps in microseconds.
+class MotionSegmenter {
+public:
+	enum Event {
+		motionNone,
+		motionStarted,
+		motionEnded
+	};
+
+	// Strokes turn the arm by a few tens of degrees in a few hundred milliseconds, well over startSpeed, while an arm
+	// held still drifts at a few degrees per second.
+	static const unsigned startSpeed = 60;
+	static const unsigned stopSpeed = 25;
+	// The gyroscope reports 50 times a second, so the arm has to stay slow for two samples in a row.
+	static const uint64_t settleDuration = 30000;
+	static const uint64_t maxStrokeDuration = 1500000;
+
+	MotionSegmenter()
+	{
+		reset();
+	}
+
+	void reset()
+	{
+		moving = false;
+		reversed = false;
+		quiet = false;
+		axis = 0;
+		peak = 0;
+		startTime = 0;
+		quietSince = 0;
+	}
+
+	bool isMoving() const
+	{
+		return moving;
+	}
+
+	// observe() takes the angular velocity about the gyroscope's x, y and z axes and returns which, if any, of the
+	// start or end of a stroke it marks.
+	Event observe(const float rates[3], uint64_t timestamp)
+	{
+		float speed = std::sqrt(rates[0] * rates[0] + rates[1] * rates[1] + rates[2] * rates[2]);
+		if (!moving) {
+			if (speed <= startSpeed) {
+				return motionNone;
+			}
+			moving = true;
+			reversed = false;
+			quiet = false;
+			startTime = timestamp;
+			axis = 0;
+			peak = 0;
+			followPeak(rates);
+			return motionStarted;
+		}
+
+		if (!reversed) {
+			followPeak(rates);
+			reversed = rates[axis] * peak < 0 && std::abs(rates[axis]) > stopSpeed;
+		}
+		if (speed >= stopSpeed) {
+			quiet = false;
+		}
+		else if (!quiet) {
+			quiet = true;
+			quietSince = timestamp;
+		}
+		if ((reversed && quiet && timestamp - quietSince >= settleDuration)
+			|| timestamp - startTime >= maxStrokeDuration) {
+			moving = false;
+			return motionEnded;
+		}
+		return motionNone;
+	}
+
+private:
+	// followPeak() keeps the axis turned about fastest on the way out, and which way it turned.
+	void followPeak(const float rates[3])
+	{
+		for (unsigned i = 0; i < 3; ++i) {
+			if (std::abs(rates[i]) > std::abs(peak)) {
+				axis = i;
+				peak = rates[i];
+			}
+		}
+	}
+
+	bool moving, reversed, quiet;
+	unsigned axis;
+	float peak;
+	uint64_t startTime, quietSince;
+};
@@ -0,0 +1,365 @@
+// Background delivery of the typed text by email or SMS, so sending never blocks the Myo event loop.
+#pragma once
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+// Leaves out the old winsock.h, which would clash with the winsock2.h telemetry-server.hpp needs.
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <spawn.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <stdint.h>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#ifndef _WIN32
+extern char** environ;
+#endif
+
+#include "latency-probes.hpp"
+
+enum NotificationChannel {
+	channelEmail,
+	channelSms,
+	channelCount
+};
+
+// Messages longer than this are truncated when they are posted.
+const unsigned maxMessageLength = 160;
+
+// A NotificationBackend delivers messages for one channel. send() is only ever called from the dispatcher thread, one
+// message at a time, so backends don't need to be thread-safe.
+class NotificationBackend {
+public:
+	virtual ~NotificationBackend() {}
+
+	// send() delivers the message and returns true if it was accepted by the provider.
+	virtual bool send(const char* text) = 0;
+};
+
+// besideExecutable() returns the path of a file in the directory the running executable was started from, so that the
+// helper scripts are found whatever the current directory is. If that directory can't be found the name is returned as
+// it is, and is looked up in the current directory.
+inline std::string besideExecutable(const std::string& name)
+{
+	char path[4096];
+#ifdef _WIN32
+	DWORD length = GetModuleFileNameA(0, path, sizeof(path));
+	if (length == 0 || length == sizeof(path)) {
+		return name;
+	}
+#else
+	ssize_t length = readlink("/proc/self/exe", path, sizeof(path));
+	if (length <= 0 || length == static_cast<ssize_t>(sizeof(path))) {
+		return name;
+	}
+#endif
+	std::string executable(path, length);
+	size_t separator = executable.find_last_of("/\\");
+	if (separator == std::string::npos) {
+		return name;
+	}
+	return executable.substr(0, separator + 1) + name;
+}
+
+// ScriptBackend delivers messages by running one of the Python helper scripts (testgrid.py, testtwil.py) with the
+// message as its only argument. The script is started directly, never through a shell, so nothing in the message is
+// ever interpreted as a command: on Windows the message is quoted the way the C runtime splits a command line back
+// into arguments, and elsewhere it is passed in its own argv entry.
+class ScriptBackend : public NotificationBackend {
+public:
+	explicit ScriptBackend(const std::string& script)
+		: script(script)
+	{
+	}
+
+	bool send(const char* text)
+	{
+#ifdef _WIN32
+		std::string commandLine = "python " + quoteArgument(script) + " " + quoteArgument(text);
+		std::vector<char> writable(commandLine.begin(), commandLine.end());
+		writable.push_back('\0');
+
+		STARTUPINFOA startup;
+		std::memset(&startup, 0, sizeof(startup));
+		startup.cb = sizeof(startup);
+		PROCESS_INFORMATION process;
+		if (!CreateProcessA(0, &writable[0], 0, 0, FALSE, 0, 0, 0, &startup, &process)) {
+			return false;
+		}
+		WaitForSingleObject(process.hProcess, INFINITE);
+		DWORD status = 1;
+		GetExitCodeProcess(process.hProcess, &status);
+		CloseHandle(process.hThread);
+		CloseHandle(process.hProcess);
+		return status == 0;
+#else
+		std::string python = "python";
+		std::vector<char*> argv;
+		argv.push_back(&python[0]);
+		argv.push_back(const_cast<char*>(script.c_str()));
+		argv.push_back(const_cast<char*>(text));
+		argv.push_back(0);
+
+		pid_t child;
+		if (posix_spawnp(&child, "python", 0, 0, &argv[0], environ) != 0) {
+			return false;
+		}
+		int status;
+		while (waitpid(child, &status, 0) < 0) {
+			if (errno != EINTR) {
+				return false;
+			}
+		}
+		return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+#endif
+	}
+
+private:
+#ifdef _WIN32
+	// quoteArgument() wraps an argument in double quotes so that the child's C runtime reads it back as exactly one
+	// argument: quotes inside it are escaped with a backslash, and so are backslashes that come before a quote.
+	static std::string quoteArgument(const std::string& argument)
+	{
+		std::string quoted = "\"";
+		unsigned backslashes = 0;
+		for (size_t i = 0; i < argument.size(); ++i) {
+			if (argument[i] == '\\') {
+				++backslashes;
+				continue;
+			}
+			if (argument[i] == '"') {
+				backslashes = backslashes * 2 + 1;
+			}
+			quoted.append(backslashes, '\\');
+			backslashes = 0;
+			quoted += argument[i];
+		}
+		quoted.append(backslashes * 2, '\\');
+		quoted += '"';
+		return quoted;
+	}
+#endif
+
+	std::string script;
+};
+
+// TokenBucket limits how often something may happen: it holds up to `burst` tokens, gains `perMinute` tokens a
+// minute, and take() spends one if there is one.
+class TokenBucket {
+public:
+	TokenBucket()
+		: burst(0), perMinute(0), tokens(0)
+	{
+	}
+
+	void configure(unsigned burstSize, unsigned tokensPerMinute, std::chrono::steady_clock::time_point now)
+	{
+		burst = burstSize;
+		perMinute = tokensPerMinute;
+		tokens = burstSize;
+		refilled = now;
+	}
+
+	bool take(std::chrono::steady_clock::time_point now)
+	{
+		double minutes = std::chrono::duration<double, std::ratio<60> >(now - refilled).count();
+		refilled = now;
+		tokens += minutes * perMinute;
+		if (tokens > burst) {
+			tokens = burst;
+		}
+		if (tokens < 1) {
+			return false;
+		}
+		tokens -= 1;
+		return true;
+	}
+
+private:
+	unsigned burst, perMinute;
+	double tokens;
+	std::chrono::steady_clock::time_point refilled;
+};
+
+// NotificationDispatcher owns a sender thread and a bounded queue of messages. post() only copies the message into the
+// queue, so it is cheap enough to call from the Myo event callbacks.
+class NotificationDispatcher {
+public:
+	static const unsigned queueCapacity = 8;
+
+	// By default each channel may send two messages at once and then one every ten seconds.
+	static const unsigned defaultBurst = 2;
+	static const unsigned defaultPerMinute = 6;
+
+	NotificationDispatcher()
+		: probes(LatencyProbes::instance()), head(0), count(0), stopping(false)
+	{
+		std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+		for (unsigned i = 0; i < channelCount; ++i) {
+			pending[i] = 0;
+			lastAccepted[i][0] = '\0';
+			limits[i].configure(defaultBurst, defaultPerMinute, now);
+		}
+		worker = std::thread(&NotificationDispatcher::run, this);
+	}
+
+	// The destructor delivers any messages that are still queued before stopping the sender thread.
+	~NotificationDispatcher()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+		}
+		wake.notify_one();
+		worker.join();
+	}
+
+	// setBackend() installs the backend for a channel. It should be called before the first post() for that channel.
+	void setBackend(NotificationChannel channel, std::unique_ptr<NotificationBackend> backend)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		backends[channel] = std::move(backend);
+	}
+
+	// setRateLimit() changes how many messages a channel may send in a burst and how many a minute after that.
+	void setRateLimit(NotificationChannel channel, unsigned burst, unsigned perMinute)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		limits[channel].configure(burst, perMinute, std::chrono::steady_clock::now());
+	}
+
+	// post() queues a message for delivery and returns true if it was accepted. In order:
+	//  - A message is dropped if the channel has no backend, or if it repeats the last message accepted on the channel
+	//    while that one is still pending or was accepted less than dedupeWindow ago.
+	//  - If a message for the channel is still waiting in the queue, the new text replaces it, so triggers that come
+	//    in while a message is being sent coalesce into one follow-up message.
+	//  - Otherwise the message takes a token from the channel's rate limit, and is dropped if there is none or the
+	//    queue is full.
+	bool post(NotificationChannel channel, const char* text)
+	{
+		std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (!backends[channel]) {
+				return false;
+			}
+			if (std::strncmp(lastAccepted[channel], text, maxMessageLength) == 0
+				&& (pending[channel] > 0 || now - lastAcceptedTime[channel] < dedupeWindow())) {
+				return false;
+			}
+			for (unsigned i = 0; i < count; ++i) {
+				Message& waiting = queue[(head + i) % queueCapacity];
+				if (waiting.channel == channel) {
+					copyText(waiting.text, text);
+					copyText(lastAccepted[channel], text);
+					lastAcceptedTime[channel] = now;
+					return true;
+				}
+			}
+			if (count == queueCapacity) {
+				return false;
+			}
+			if (!limits[channel].take(now)) {
+				return false;
+			}
+
+			Message& message = queue[(head + count) % queueCapacity];
+			message.channel = channel;
+			message.postedAt = probes.isEnabled() ? probeClock() : 0;
+			copyText(message.text, text);
+			copyText(lastAccepted[channel], text);
+			lastAcceptedTime[channel] = now;
+			++pending[channel];
+			++count;
+		}
+		wake.notify_one();
+		return true;
+	}
+
+private:
+	struct Message {
+		NotificationChannel channel;
+		int64_t postedAt;
+		char text[maxMessageLength + 1];
+	};
+
+	static std::chrono::steady_clock::duration dedupeWindow()
+	{
+		return std::chrono::seconds(5);
+	}
+
+	static void copyText(char* destination, const char* text)
+	{
+		std::strncpy(destination, text, maxMessageLength);
+		destination[maxMessageLength] = '\0';
+	}
+
+	void run()
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		for (;;) {
+			wake.wait(lock, [this] { return stopping || count > 0; });
+			if (count == 0) {
+				return;
+			}
+
+			Message message = queue[head];
+			head = (head + 1) % queueCapacity;
+			--count;
+			NotificationBackend* backend = backends[message.channel].get();
+
+			// Deliver without holding the lock so post() never waits on the network.
+			lock.unlock();
+			if (probes.isEnabled() && message.postedAt) {
+				int64_t started = probeClock();
+				backend->send(message.text);
+				probes.record(spanDispatchWait, message.channel, message.postedAt, started);
+				probes.record(spanSend, message.channel, started, probeClock());
+			}
+			else {
+				backend->send(message.text);
+			}
+			lock.lock();
+
+			--pending[message.channel];
+		}
+	}
+
+	LatencyProbes& probes;
+	std::unique_ptr<NotificationBackend> backends[channelCount];
+
+	Message queue[queueCapacity];
+	unsigned head, count;
+
+	// The last message accepted on each channel, how many of that channel's messages are queued or being sent, and
+	// when the last one was accepted. These are used to drop repeated posts.
+	char lastAccepted[channelCount][maxMessageLength + 1];
+	unsigned pending[channelCount];
+	std::chrono::steady_clock::time_point lastAcceptedTime[channelCount];
+
+	// Each channel's rate limit.
+	TokenBucket limits[channelCount];
+
+	bool stopping;
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::thread worker;
+};
@@ -0,0 +1,208 @@
+// Noise filters for the scaled orientation, applied once per sample before anything else sees it.
+#pragma once
+
+#include <cmath>
+#include <stdint.h>
+
+#include "orientation.hpp"
+
+// MedianFilter outputs the median of the last Length inputs. A single spike never gets through, since it can't be the
+// middle value, while a real change of level gets through (Length - 1) / 2 samples late. It keeps the window both in
+// arrival order and sorted, so each sample costs O(Length) whatever the data, and nothing is allocated.
+template<unsigned Length>
+class MedianFilter {
+	static_assert(Length % 2 == 1, "the median of an even window isn't one of its values");
+
+public:
+	MedianFilter()
+		: oldest(0), count(0)
+	{
+	}
+
+	void reset()
+	{
+		oldest = 0;
+		count = 0;
+	}
+
+	float filter(float value)
+	{
+		unsigned size = count;
+		if (count == Length) {
+			// Take the value leaving the window out of the sorted copy.
+			unsigned leaving = find(ring[oldest]);
+			for (unsigned i = leaving; i + 1 < Length; ++i) {
+				sorted[i] = sorted[i + 1];
+			}
+			--size;
+		}
+		else {
+			++count;
+		}
+		ring[oldest] = value;
+		oldest = oldest + 1 == Length ? 0 : oldest + 1;
+
+		unsigned i = size;
+		while (i > 0 && sorted[i - 1] > value) {
+			sorted[i] = sorted[i - 1];
+			--i;
+		}
+		sorted[i] = value;
+		return sorted[count / 2];
+	}
+
+private:
+	unsigned find(float value) const
+	{
+		unsigned i = 0;
+		while (i + 1 < Length && sorted[i] != value) {
+			++i;
+		}
+		return i;
+	}
+
+	float ring[Length];
+	float sorted[Length];
+	unsigned oldest, count;
+};
+
+// OneEuroFilter is the 1€ filter of Casiez, Roussel and Vogel: a low-pass filter whose cutoff rises with the speed of
+// the signal. At rest the cutoff is minCutoff, which smooths out jitter; during a stroke it rises by beta per unit per
+// second, so the stroke itself isn't delayed. Frequencies are in Hz and times in seconds.
+class OneEuroFilter {
+public:
+	OneEuroFilter()
+		: primed(false), previous(0), derivative(0)
+	{
+	}
+
+	void reset()
+	{
+		primed = false;
+	}
+
+	float filter(float value, double elapsed, double minCutoff, double beta, double derivativeCutoff)
+	{
+		if (!primed || elapsed <= 0) {
+			primed = true;
+			previous = value;
+			derivative = 0;
+			return value;
+		}
+		double speed = (value - previous) / elapsed;
+		derivative += smoothing(elapsed, derivativeCutoff) * (speed - derivative);
+		double cutoff = minCutoff + beta * std::abs(derivative);
+		previous += smoothing(elapsed, cutoff) * (value - previous);
+		return static_cast<float>(previous);
+	}
+
+private:
+	// smoothing() is the weight of a new sample in an exponential filter with the given cutoff.
+	static double smoothing(double elapsed, double cutoff)
+	{
+		const double pi = 3.14159265358979323846;
+		double tau = 1 / (2 * pi * cutoff);
+		return 1 / (1 + tau / elapsed);
+	}
+
+	bool primed;
+	double previous;
+	double derivative;
+};
+
+// The filter stages that can be chained, see OrientationFilter.
+enum FilterStage {
+	filterMedian,
+	filterOneEuro
+};
+
+// FilterSettings says which stages to run, in order, and how the 1€ stage is tuned. With no stages the orientation is
+// passed through untouched.
+struct FilterSettings {
+	static const unsigned maxStages = 2;
+
+	FilterSettings()
+		: stageCount(0), minCutoff(1.0), beta(1.0), derivativeCutoff(1.0)
+	{
+	}
+
+	FilterStage stages[maxStages];
+	unsigned stageCount;
+	double minCutoff, beta, derivativeCutoff;
+};
+
+// OrientationFilter runs each axis of an armband's orientation through the stages chosen in a FilterSettings. Roll
+// and yaw wrap around from 18 to 0, which would look like a spike to the filters, so they are unwrapped before
+// filtering and wrapped again after.
+class OrientationFilter {
+public:
+	// A median of five delays a change of level by two samples, which at the Myo's 50 Hz is 40 ms.
+	static const unsigned medianLength = 5;
+
+	OrientationFilter()
+	{
+		reset();
+	}
+
+	void reset()
+	{
+		started = false;
+		lastTimestamp = 0;
+		for (unsigned axis = 0; axis < 3; ++axis) {
+			median[axis].reset();
+			oneEuro[axis].reset();
+			unwrapped[axis] = 0;
+		}
+	}
+
+	// filter() takes a sample and its SDK timestamp in microseconds, and returns the filtered sample.
+	ScaledOrientation filter(const ScaledOrientation& sample, uint64_t timestamp, const FilterSettings& settings)
+	{
+		if (settings.stageCount == 0) {
+			return sample;
+		}
+		double elapsed = started ? (timestamp - lastTimestamp) / 1e6 : 0;
+		lastTimestamp = timestamp;
+
+		float values[3] = { sample.roll_w, sample.pitch_w, sample.yaw_w };
+		static const bool wraps[3] = { true, false, true };
+		for (unsigned axis = 0; axis < 3; ++axis) {
+			float value = values[axis];
+			if (wraps[axis]) {
+				if (started) {
+					float turns = std::floor((unwrapped[axis] - value) / 18 + 0.5f);
+					value += 18 * turns;
+				}
+				unwrapped[axis] = value;
+			}
+			for (unsigned stage = 0; stage < settings.stageCount; ++stage) {
+				if (settings.stages[stage] == filterMedian) {
+					value = median[axis].filter(value);
+				}
+				else {
+					value = oneEuro[axis].filter(value, elapsed, settings.minCutoff, settings.beta,
+						settings.derivativeCutoff);
+				}
+			}
+			if (wraps[axis]) {
+				value -= 18 * std::floor(value / 18);
+			}
+			values[axis] = value;
+		}
+		started = true;
+
+		ScaledOrientation filtered;
+		filtered.roll_w = values[0];
+		filtered.pitch_w = values[1];
+		filtered.yaw_w = values[2];
+		return filtered;
+	}
+
+private:
+	bool started;
+	uint64_t lastTimestamp;
+	MedianFilter<medianLength> median[3];
+	OneEuroFilter oneEuro[3];
+	// The last input on each axis with whole turns added back, so that unwrapping follows the arm round and round.
+	float unwrapped[3];
+};
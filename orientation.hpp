@@ -0,0 +1,51 @@
+// Conversion of Myo orientation quaternions to the 0 to 18 scale used for display and recognition.
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+
+#include "fast-math.hpp"
+
+// ScaledOrientation holds roll, pitch and yaw, each mapped from its range in radians onto a scale from 0 to 18.
+struct ScaledOrientation {
+	float roll_w, pitch_w, yaw_w;
+};
+
+// scaleOrientation() calculates the Euler angles (roll, pitch, and yaw) of the unit quaternion (x, y, z, w) and maps
+// them onto the 0 to 18 scale. With `fast` set, the polynomial approximations from fast-math.hpp are used instead of
+// the library functions. Their error of under 1e-4 radians is far below the 0.35 radians that one step of the scale
+// covers.
+inline ScaledOrientation scaleOrientation(float x, float y, float z, float w, bool fast)
+{
+	using std::atan2;
+	using std::asin;
+	using std::max;
+	using std::min;
+
+	const double pi = 3.14159265358979323846;
+
+	float rollY = 2.0f * (w * x + y * z);
+	float rollX = 1.0f - 2.0f * (x * x + y * y);
+	float sinPitch = max(-1.0f, min(1.0f, 2.0f * (w * y - z * x)));
+	float yawY = 2.0f * (w * z + x * y);
+	float yawX = 1.0f - 2.0f * (y * y + z * z);
+
+	float roll, pitch, yaw;
+	if (fast) {
+		roll = fastmath::atan2(rollY, rollX);
+		pitch = fastmath::asin(sinPitch);
+		yaw = fastmath::atan2(yawY, yawX);
+	}
+	else {
+		roll = atan2(rollY, rollX);
+		pitch = asin(sinPitch);
+		yaw = atan2(yawY, yawX);
+	}
+
+	// Convert the floating point angles in radians to a scale from 0 to 18.
+	ScaledOrientation scaled;
+	scaled.roll_w = static_cast<float>((roll + (float)pi) / (pi * 2.0f) * 18);
+	scaled.pitch_w = static_cast<float>((pitch + (float)pi / 2.0f) / pi * 18);
+	scaled.yaw_w = static_cast<float>((yaw + (float)pi) / (pi * 2.0f) * 18);
+	return scaled;
+}
@@ -0,0 +1,304 @@
+// Gesture recognition for a single armband, independent of the Myo SDK types.
+#pragma once
+
+#include <cmath>
+#include <iostream>
+#include <stdint.h>
+
+#include "alphabet.hpp"
+#include "calibration.hpp"
+#include "input-buffers.hpp"
+#include "motion-segmenter.hpp"
+#include "stroke-classifiers.hpp"
+
+// BasicRecognizer turns a stream of orientation samples into letters and commands. Orientation values are on the 0 to
+// 18 scale computed in DataCollector::onOrientationData(), and timestamps are the SDK event timestamps in microseconds.
+// How a stroke's axis and direction are decided is up to the Classifier, see stroke-classifiers.hpp. How close to home
+// counts as home, and how much each axis weighs with the classifier, come from the StrokeCalibration, see
+// calibration.hpp. What the strokes spell comes from an AlphabetIndex, see alphabet.hpp. With `fusion` set, strokes
+// start and end with the arm's motion as the gyroscope sees it instead, see trackMotion().
+template<typename Classifier>
+class BasicRecognizer {
+public:
+	// confirmLetter() decodes the strokes recorded since the last fist into a letter or command and makes the current
+	// orientation the new home position. Holding the fist keeps firing once per cooldown, which is how an empty stroke
+	// sequence (a space) gets entered.
+	void confirmLetter(float roll_w, float pitch_w, float yaw_w)
+	{
+		if (segmentState == segmentCooldown) {
+			return;
+		}
+
+		if (verbose) {
+			std::cout << "fist\n";
+		}
+		home_roll = roll_w;
+		home_yaw = yaw_w;
+		home_pitch = pitch_w;
+		GestureSymbol symbol = alphabet->current().symbolFor(strokes.code());
+		strokes.clear();
+		enterSymbol(symbol);
+		beginStroke();
+		beginCooldown();
+	}
+
+	// trackStroke() advances the gesture segmentation state machine with the current orientation. In segmentIdle we
+	// wait for the arm to leave the home position, in segmentTracking we record the peak delta on each axis until the
+	// arm returns home, and in segmentCooldown input is ignored until the pause after a stroke or letter has elapsed.
+	// With fusion the orientation is only recorded; trackMotion() decides when strokes start and end.
+	void trackStroke(float roll_w, float pitch_w, float yaw_w)
+	{
+		// No home position has been set by a fist yet, or we are pausing after the last stroke.
+		if (home_roll < 0 || segmentState == segmentCooldown) {
+			return;
+		}
+
+		float roll = roll_w - home_roll, pitch = pitch_w - home_pitch, yaw = yaw_w - home_yaw;
+		bool atHome = epsilonCompare(roll_w, home_roll, calibration.tolerance(0))
+			&& epsilonCompare(pitch_w, home_pitch, calibration.tolerance(1))
+			&& epsilonCompare(yaw_w, home_yaw, calibration.tolerance(2));
+
+		if (segmentState == segmentIdle) {
+			if (atHome || fusion) {
+				if (atHome && calibrating) {
+					calibration.observeHome(roll, pitch, yaw);
+				}
+				return;
+			}
+			segmentState = segmentTracking;
+		}
+		else if (atHome && !fusion) {
+			finishStroke();
+			return;
+		}
+
+		// Let the classifier observe the delta from home on each axis, weighted by the calibration. The calibration
+		// itself learns from the unweighted peaks.
+		const float offsets[3] = { roll, pitch, yaw };
+		for (unsigned axis = 0; axis < 3; ++axis) {
+			if (std::abs(offsets[axis]) > strokePeaks[axis]) {
+				strokePeaks[axis] = std::abs(offsets[axis]);
+			}
+		}
+		classifier.observe(calibration.gain(0) * roll, calibration.gain(1) * pitch, calibration.gain(2) * yaw);
+	}
+
+	// trackMotion() advances the segmentation with the angular velocity from the gyroscope, in degrees per second, when
+	// fusion is set. A stroke starts as soon as the arm moves, and ends a few tens of milliseconds after the arm
+	// has come back and stopped (see motion-segmenter.hpp), with only the short strokeSettleDuration of cooldown after
+	// it. The orientation samples in between, passed to trackStroke(), decide which stroke it was.
+	void trackMotion(const float rates[3], uint64_t timestamp)
+	{
+		MotionSegmenter::Event event = motion.observe(rates, timestamp);
+		if (!fusion || home_roll < 0) {
+			return;
+		}
+		if (segmentState == segmentIdle && motion.isMoving()) {
+			segmentState = segmentTracking;
+		}
+		else if (segmentState == segmentTracking && event == MotionSegmenter::motionEnded) {
+			finishStroke();
+		}
+	}
+
+	// finishStroke() classifies the stroke that has just ended and enters it.
+	void finishStroke()
+	{
+		Stroke stroke = classifier.classify();
+		if (stroke != strokeNone) {
+			strokes.push(stroke);
+			if (calibrating) {
+				calibration.observeStroke(stroke, strokePeaks);
+			}
+		}
+		if (verbose) {
+			std::cout << (fusion ? "stroke ended\n" : "home reached\n");
+			classifier.describe(std::cout);
+			if (stroke != strokeNone) {
+				std::cout << strokeNames[stroke] << '\n';
+			}
+		}
+		if (incremental && stroke != strokeNone) {
+			decodeIncrementally();
+		}
+		beginStroke();
+		beginCooldown(fusion ? static_cast<uint64_t>(strokeSettleDuration) : static_cast<uint64_t>(cooldownDuration));
+	}
+
+	// beginStroke() forgets what was observed of the last stroke.
+	void beginStroke()
+	{
+		classifier.reset();
+		for (unsigned axis = 0; axis < 3; ++axis) {
+			strokePeaks[axis] = 0;
+		}
+	}
+
+	// decodeIncrementally() looks at the strokes entered since the last letter as a prefix of the alphabet. When only
+	// one symbol starts with them, it is entered straight away instead of waiting for a fist; when none does, they are
+	// dropped. Otherwise the remaining candidates are echoed, and a fist still enters what the strokes spell so far.
+	void decodeIncrementally()
+	{
+		const AlphabetIndex& index = alphabet->current();
+		unsigned prefix = strokes.code();
+		GestureSymbol symbol = index.completionFor(prefix);
+		if (symbol.action != actionNone) {
+			strokes.clear();
+			enterSymbol(symbol);
+		}
+		else if (index.candidatesFor(prefix) == 0) {
+			strokes.clear();
+			if (verbose) {
+				std::cout << "no letter starts with these strokes\n";
+			}
+		}
+		else if (verbose) {
+			std::cout << "candidates:";
+			index.describeCandidates(prefix, std::cout);
+			std::cout << '\n';
+		}
+	}
+
+	// enterSymbol() carries out a decoded symbol: letters go to enterLetter(), backspace and clear edit the word, and
+	// the send commands are left in lastAction for whoever sends messages. Strokes that spell nothing still echo the
+	// word.
+	void enterSymbol(GestureSymbol symbol)
+	{
+		lastAction = static_cast<GestureAction>(symbol.action);
+		if (symbol.action == actionLetter || symbol.action == actionNone) {
+			enterLetter(symbol.letter);
+			return;
+		}
+		if (symbol.action == actionBackspace) {
+			word.backspace();
+		}
+		else if (symbol.action == actionClear) {
+			word.clear();
+		}
+		if (verbose) {
+			AlphabetIndex::describe(symbol, std::cout);
+			std::cout << '\n' << word.c_str() << '\n';
+		}
+	}
+
+	// takeAction() returns what the last symbol entered was, once, or actionNone if nothing has been entered since.
+	GestureAction takeAction()
+	{
+		GestureAction action = lastAction;
+		lastAction = actionNone;
+		return action;
+	}
+
+	// enterLetter() appends a decoded letter to the word, if there is one and the word has room, and echoes the result.
+	void enterLetter(char letter)
+	{
+		bool appended = letter && word.append(letter);
+		if (verbose) {
+			if (letter) {
+				std::cout << letter << '\n';
+				if (!appended) {
+					std::cout << "word is full\n";
+				}
+			}
+			std::cout << word.c_str() << '\n';
+		}
+	}
+
+	// reset() forgets the home position, the calibration and everything entered so far, but keeps the settings,
+	// including the classifier's.
+	void reset()
+	{
+		bool keepVerbose = verbose;
+		bool keepIncremental = incremental;
+		bool keepCalibrating = calibrating;
+		bool keepFusion = fusion;
+		const AlphabetSlot* keepAlphabet = alphabet;
+		Classifier keepClassifier = classifier;
+		*this = BasicRecognizer();
+		verbose = keepVerbose;
+		incremental = keepIncremental;
+		calibrating = keepCalibrating;
+		fusion = keepFusion;
+		alphabet = keepAlphabet;
+		classifier = keepClassifier;
+		classifier.reset();
+	}
+
+	// beginCooldown() starts the pause that follows a stroke or a letter. It is measured against the SDK event
+	// timestamps rather than the wall clock, so the Myo event loop keeps running while we wait.
+	void beginCooldown(uint64_t duration = cooldownDuration)
+	{
+		segmentState = segmentCooldown;
+		cooldownEnd = lastTimestamp + duration;
+	}
+
+	// advanceClock() is called with the timestamp of every event we receive and ends the cooldown once it expires.
+	void advanceClock(uint64_t timestamp)
+	{
+		lastTimestamp = timestamp;
+		if (segmentState == segmentCooldown && timestamp >= cooldownEnd) {
+			segmentState = segmentIdle;
+		}
+	}
+
+	bool epsilonCompare(float var1, float var2, float err)
+	{
+		return !(var2 < var1 - err ||
+			var2 > var1 + err);
+	}
+
+	// Set to echo each stroke and letter to std::cout as it is recognized.
+	bool verbose = true;
+
+	// Set to enter a letter as soon as its strokes can't be the start of any other, see decodeIncrementally().
+	bool incremental = false;
+
+	// Set to have the calibration learn from every sample and stroke; otherwise it keeps whatever it was given.
+	bool calibrating = false;
+
+	// Set to segment strokes by the gyroscope's readings, passed to trackMotion(), instead of by returns home.
+	bool fusion = false;
+
+	// Where the alphabet is looked up. Whoever loads alphabets may replace the one in the slot at any time.
+	const AlphabetSlot* alphabet = &AlphabetSlot::builtIn();
+
+	float home_roll = -1, home_yaw = -1, home_pitch = -1;
+
+	// Decides the axis and direction of each stroke from the deltas observed while the arm is away from home.
+	Classifier classifier;
+
+	// The home tolerance and axis weights for the person wearing the armband, and the unweighted peak offset from
+	// home on roll, pitch and yaw during the current stroke.
+	StrokeCalibration calibration;
+	float strokePeaks[3] = { 0, 0, 0 };
+
+	// The strokes entered since the last fist, and the text entered so far. Both have a fixed capacity so that
+	// entering text never allocates; see input-buffers.hpp for what happens when they fill up.
+	static const unsigned wordCapacity = 160;
+	StrokeBuffer<maxGestureStrokes> strokes;
+	WordBuffer<wordCapacity> word;
+
+	// What the last symbol entered was, see takeAction().
+	GestureAction lastAction = actionNone;
+
+	// Follows the arm's angular velocity for trackMotion().
+	MotionSegmenter motion;
+
+	// Gesture segmentation state, advanced by trackStroke(), trackMotion() and confirmLetter().
+	enum SegmentState {
+		segmentIdle,
+		segmentTracking,
+		segmentCooldown
+	};
+	SegmentState segmentState = segmentIdle;
+
+	// Timestamp (in microseconds) of the most recent event, and the time at which the current cooldown ends.
+	uint64_t lastTimestamp = 0;
+	uint64_t cooldownEnd = 0;
+	static const uint64_t cooldownDuration = 2000000;
+	// With fusion a stroke is known to be over when it ends, so the pause after it only lets the arm steady itself.
+	static const uint64_t strokeSettleDuration = 100000;
+};
+
+// Recognizer is the recognizer with the original peak-per-axis classification.
+typedef BasicRecognizer<AxisPeakClassifier> Recognizer;
@@ -0,0 +1,91 @@
+// A sequence lock: one writer publishes a value that any number of readers copy, without either side taking a lock.
+#pragma once
+
+#include <atomic>
+#include <cstring>
+#include <stdint.h>
+#include <type_traits>
+
+// Seqlock holds a copy of a trivially copyable T. store() may only be called from one thread at a time and never
+// waits; its readers can be on any threads and never write to it, so they don't slow the writer down either. A reader
+// copies the value out and checks the sequence number around the copy: the number is odd while a store is under way
+// and goes up with every store, so a copy that overlapped a store is noticed and retried, and a reader never sees half
+// of one value and half of another.
+//
+// The value is kept in relaxed atomic words rather than as a plain T, so that a copy racing with a store is a
+// well-defined (if useless) read instead of a data race. The sequence number and the value share cache lines, and
+// the whole lock starts on one of its own.
+template<typename T>
+class alignas(64) Seqlock {
+	static_assert(std::is_trivially_copyable<T>::value, "a Seqlock can only hold values it may copy bytewise");
+
+public:
+	Seqlock()
+		: sequence(0)
+	{
+		store(T());
+	}
+
+	// store() publishes a new value.
+	void store(const T& value)
+	{
+		uint64_t staged[wordCount] = {};
+		std::memcpy(staged, &value, sizeof(T));
+
+		unsigned current = sequence.load(std::memory_order_relaxed);
+		sequence.store(current + 1, std::memory_order_relaxed);
+		// Keeps the stores to the value from being seen before the odd sequence number.
+		std::atomic_thread_fence(std::memory_order_release);
+		for (unsigned i = 0; i < wordCount; ++i) {
+			words[i].store(staged[i], std::memory_order_relaxed);
+		}
+		sequence.store(current + 2, std::memory_order_release);
+	}
+
+	// tryLoad() copies the value into `value` and returns true, or returns false, leaving `value` alone, if a store
+	// was under way.
+	bool tryLoad(T& value) const
+	{
+		unsigned before = sequence.load(std::memory_order_acquire);
+		if (before & 1) {
+			return false;
+		}
+		uint64_t copied[wordCount];
+		for (unsigned i = 0; i < wordCount; ++i) {
+			copied[i] = words[i].load(std::memory_order_relaxed);
+		}
+		// Keeps the loads of the value from being moved after the second look at the sequence number.
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if (sequence.load(std::memory_order_relaxed) != before) {
+			return false;
+		}
+		std::memcpy(&value, copied, sizeof(T));
+		return true;
+	}
+
+	// load() returns the value, retrying for as long as stores keep overlapping the copy. A store takes a few dozen
+	// nanoseconds, so in practice it succeeds the first or second time.
+	T load() const
+	{
+		T value;
+		while (!tryLoad(value)) {
+		}
+		return value;
+	}
+
+	// version() goes up by one with every store, so a reader can tell whether anything was published since it last
+	// looked without copying the value.
+	unsigned version() const
+	{
+		return sequence.load(std::memory_order_acquire) / 2;
+	}
+
+private:
+	Seqlock(const Seqlock&);
+	Seqlock& operator=(const Seqlock&);
+
+	static const unsigned wordCount = (sizeof(T) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+
+	std::atomic<unsigned> sequence;
+	std::atomic<uint64_t> words[wordCount];
+};
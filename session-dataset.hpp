@@ -0,0 +1,593 @@
+// Recorded sessions in a columnar layout for bulk analysis, with the letters the recognizer decoded as labels.
+#pragma once
+
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "armband-recognition.hpp"
+#include "mapped-file.hpp"
+#include "orientation.hpp"
+#include "recognizer.hpp"
+#include "session-recorder.hpp"
+
+// SessionDataset holds the events of a session as one array per field ("struct of arrays"), channel by channel, so
+// that analysis tools can take a whole channel, say every yaw angle, in one read. Every event row has the index of
+// its record in the session (`sequence`), which puts the channels back in the order the events arrived. The letters
+// are the labels: each spans the time from the previous letter on its armband (or the start of the session) to the
+// fist that entered it, with the gesture code the strokes in between made.
+struct SessionDataset {
+	struct Orientation {
+		std::vector<uint32_t> sequence;
+		std::vector<uint64_t> timestamp;
+		std::vector<uint8_t> armband;
+		std::vector<float> x, y, z, w;
+	};
+
+	struct Gyroscope {
+		std::vector<uint32_t> sequence;
+		std::vector<uint64_t> timestamp;
+		std::vector<uint8_t> armband;
+		std::vector<float> x, y, z;
+	};
+
+	struct Pose {
+		std::vector<uint32_t> sequence;
+		std::vector<uint64_t> timestamp;
+		std::vector<uint8_t> armband;
+		std::vector<uint16_t> type;
+	};
+
+	struct Emg {
+		std::vector<uint32_t> sequence;
+		std::vector<uint64_t> timestamp;
+		std::vector<uint8_t> armband;
+		std::vector<int8_t> channels[8];
+	};
+
+	// Arm sync and unsync events; `synced` is 1 for a sync.
+	struct ArmState {
+		std::vector<uint32_t> sequence;
+		std::vector<uint64_t> timestamp;
+		std::vector<uint8_t> armband;
+		std::vector<uint8_t> synced;
+	};
+
+	// The times a Myo was unpaired, which frees its armband's slot.
+	struct Unpair {
+		std::vector<uint32_t> sequence;
+		std::vector<uint64_t> timestamp;
+		std::vector<uint8_t> armband;
+	};
+
+	struct Letters {
+		std::vector<uint8_t> armband;
+		std::vector<uint64_t> start, end;
+		std::vector<uint16_t> code;
+		std::vector<uint8_t> letter;
+	};
+
+	Orientation orientation;
+	Gyroscope gyroscope;
+	Pose pose;
+	Emg emg;
+	ArmState arm;
+	Unpair unpair;
+	Letters letters;
+
+	// visitColumns() calls `visit(name, column)` for every column, in file order. Reading and writing both go through
+	// it, so the two can't disagree on the layout.
+	template<typename Visitor>
+	void visitColumns(Visitor& visit)
+	{
+		static const char* const emgNames[8] = { "emg.0", "emg.1", "emg.2", "emg.3", "emg.4", "emg.5", "emg.6",
+			"emg.7" };
+		visit("orientation.sequence", orientation.sequence);
+		visit("orientation.timestamp", orientation.timestamp);
+		visit("orientation.armband", orientation.armband);
+		visit("orientation.x", orientation.x);
+		visit("orientation.y", orientation.y);
+		visit("orientation.z", orientation.z);
+		visit("orientation.w", orientation.w);
+		visit("gyroscope.sequence", gyroscope.sequence);
+		visit("gyroscope.timestamp", gyroscope.timestamp);
+		visit("gyroscope.armband", gyroscope.armband);
+		visit("gyroscope.x", gyroscope.x);
+		visit("gyroscope.y", gyroscope.y);
+		visit("gyroscope.z", gyroscope.z);
+		visit("pose.sequence", pose.sequence);
+		visit("pose.timestamp", pose.timestamp);
+		visit("pose.armband", pose.armband);
+		visit("pose.type", pose.type);
+		visit("emg.sequence", emg.sequence);
+		visit("emg.timestamp", emg.timestamp);
+		visit("emg.armband", emg.armband);
+		for (unsigned i = 0; i < 8; ++i) {
+			visit(emgNames[i], emg.channels[i]);
+		}
+		visit("arm.sequence", arm.sequence);
+		visit("arm.timestamp", arm.timestamp);
+		visit("arm.armband", arm.armband);
+		visit("arm.synced", arm.synced);
+		visit("unpair.sequence", unpair.sequence);
+		visit("unpair.timestamp", unpair.timestamp);
+		visit("unpair.armband", unpair.armband);
+		visit("letter.armband", letters.armband);
+		visit("letter.start", letters.start);
+		visit("letter.end", letters.end);
+		visit("letter.code", letters.code);
+		visit("letter.letter", letters.letter);
+	}
+};
+
+// A dataset file is a DatasetHeader, columnCount DatasetColumns describing the columns, and then the columns' values
+// as plain arrays, each starting on an 8-byte boundary of the file. Everything is in the host's (little-endian) byte
+// order, so a column can be read straight into an array, for example with numpy.fromfile() at its offset.
+struct DatasetHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t columnCount;
+};
+
+enum DatasetColumnType {
+	columnUint8 = 1,
+	columnInt8,
+	columnUint16,
+	columnUint32,
+	columnUint64,
+	columnFloat32
+};
+
+struct DatasetColumn {
+	char name[24];
+	uint8_t type;
+	uint8_t reserved[7];
+	uint64_t count;
+	uint64_t offset;
+};
+
+static_assert(sizeof(DatasetHeader) == 16 && sizeof(DatasetColumn) == 48, "dataset files must keep their layout");
+
+const char datasetMagic[8] = { 'M', 'Y', 'O', 'D', 'A', 'T', 'A', '\0' };
+// Version 2 has gesture codes with three bits per stroke, see letter-table.hpp.
+const uint32_t datasetVersion = 2;
+
+template<typename T> struct DatasetColumnTypeOf;
+template<> struct DatasetColumnTypeOf<uint8_t> { static const uint8_t value = columnUint8; };
+template<> struct DatasetColumnTypeOf<int8_t> { static const uint8_t value = columnInt8; };
+template<> struct DatasetColumnTypeOf<uint16_t> { static const uint8_t value = columnUint16; };
+template<> struct DatasetColumnTypeOf<uint32_t> { static const uint8_t value = columnUint32; };
+template<> struct DatasetColumnTypeOf<uint64_t> { static const uint8_t value = columnUint64; };
+template<> struct DatasetColumnTypeOf<float> { static const uint8_t value = columnFloat32; };
+
+// readSessionChannels() fills a dataset's channels from a session file written by SessionRecorder, leaving the letters
+// empty. It throws std::runtime_error if the file isn't a session.
+inline SessionDataset readSessionChannels(const std::string& path)
+{
+	MappedFile file(path);
+	SessionHeader header;
+	if (file.size() < sizeof(header)) {
+		throw std::runtime_error(path + " is not a session file");
+	}
+	std::memcpy(&header, file.data(), sizeof(header));
+	if (std::memcmp(header.magic, sessionMagic, sizeof(header.magic)) != 0 || header.version != sessionVersion
+		|| header.recordSize != sizeof(SessionRecord)) {
+		throw std::runtime_error(path + " is not a session file this version can read");
+	}
+
+	SessionDataset dataset;
+	size_t count = (file.size() - sizeof(header)) / sizeof(SessionRecord);
+	for (size_t i = 0; i < count; ++i) {
+		SessionRecord record;
+		std::memcpy(&record, file.data() + sizeof(header) + i * sizeof(record), sizeof(record));
+		uint32_t sequence = static_cast<uint32_t>(i);
+		switch (record.type) {
+		case recordOrientation:
+			dataset.orientation.sequence.push_back(sequence);
+			dataset.orientation.timestamp.push_back(record.timestamp);
+			dataset.orientation.armband.push_back(record.armband);
+			dataset.orientation.x.push_back(record.values[0]);
+			dataset.orientation.y.push_back(record.values[1]);
+			dataset.orientation.z.push_back(record.values[2]);
+			dataset.orientation.w.push_back(record.values[3]);
+			break;
+		case recordGyroscope:
+			dataset.gyroscope.sequence.push_back(sequence);
+			dataset.gyroscope.timestamp.push_back(record.timestamp);
+			dataset.gyroscope.armband.push_back(record.armband);
+			dataset.gyroscope.x.push_back(record.values[0]);
+			dataset.gyroscope.y.push_back(record.values[1]);
+			dataset.gyroscope.z.push_back(record.values[2]);
+			break;
+		case recordPose:
+			dataset.pose.sequence.push_back(sequence);
+			dataset.pose.timestamp.push_back(record.timestamp);
+			dataset.pose.armband.push_back(record.armband);
+			dataset.pose.type.push_back(record.code);
+			break;
+		case recordEmg: {
+			int8_t emg[8];
+			std::memcpy(emg, record.values, sizeof(emg));
+			dataset.emg.sequence.push_back(sequence);
+			dataset.emg.timestamp.push_back(record.timestamp);
+			dataset.emg.armband.push_back(record.armband);
+			for (unsigned channel = 0; channel < 8; ++channel) {
+				dataset.emg.channels[channel].push_back(emg[channel]);
+			}
+			break;
+		}
+		case recordArmSync:
+		case recordArmUnsync:
+			dataset.arm.sequence.push_back(sequence);
+			dataset.arm.timestamp.push_back(record.timestamp);
+			dataset.arm.armband.push_back(record.armband);
+			dataset.arm.synced.push_back(record.type == recordArmSync ? 1 : 0);
+			break;
+		case recordUnpair:
+			dataset.unpair.sequence.push_back(sequence);
+			dataset.unpair.timestamp.push_back(record.timestamp);
+			dataset.unpair.armband.push_back(record.armband);
+			break;
+		default:
+			// Pairing and locking don't change what recognition sees.
+			break;
+		}
+	}
+	return dataset;
+}
+
+// DecoderSettings are the choices a recognizer policy has beyond its stroke classifier.
+struct DecoderSettings {
+	DecoderSettings()
+		: fastEuler(false), fusion(false)
+	{
+	}
+
+	bool fastEuler;
+	bool fusion;
+};
+
+// DatasetDecoder runs the events of a dataset through one recognizer per armband with recognizeSample(), as
+// DataCollector::recognize() does, and collects every letter they enter, labelled like SessionDataset::letters. It sees
+// the events the way the collector does without --service: repeats of an armband's pose are dropped, and an armband
+// starts over when its Myo is unpaired. It needs no Myo SDK, and decoding one dataset touches no state shared with any
+// other, so datasets can be decoded on as many threads as there are.
+template<typename Classifier>
+class DatasetDecoder {
+public:
+	DatasetDecoder(const SessionDataset& dataset, const DecoderSettings& settings)
+		: dataset(dataset), settings(settings), armbands(256)
+	{
+		for (size_t i = 0; i < armbands.size(); ++i) {
+			armbands[i].recognizer.verbose = false;
+			armbands[i].recognizer.fusion = settings.fusion;
+		}
+	}
+
+	SessionDataset::Letters decode()
+	{
+		const SessionDataset::Orientation& orientation = dataset.orientation;
+		const SessionDataset::Gyroscope& gyroscope = dataset.gyroscope;
+		const SessionDataset::Pose& pose = dataset.pose;
+		const SessionDataset::ArmState& arm = dataset.arm;
+		const SessionDataset::Unpair& unpair = dataset.unpair;
+		size_t o = 0, g = 0, p = 0, a = 0, u = 0;
+		for (;;) {
+			// Take whichever channel's next event arrived first.
+			uint32_t next = noEvent;
+			unsigned channel = 0;
+			if (o < orientation.sequence.size() && orientation.sequence[o] < next) {
+				next = orientation.sequence[o];
+				channel = 1;
+			}
+			if (g < gyroscope.sequence.size() && gyroscope.sequence[g] < next) {
+				next = gyroscope.sequence[g];
+				channel = 2;
+			}
+			if (p < pose.sequence.size() && pose.sequence[p] < next) {
+				next = pose.sequence[p];
+				channel = 3;
+			}
+			if (a < arm.sequence.size() && arm.sequence[a] < next) {
+				next = arm.sequence[a];
+				channel = 4;
+			}
+			if (u < unpair.sequence.size() && unpair.sequence[u] < next) {
+				next = unpair.sequence[u];
+				channel = 5;
+			}
+			if (channel == 0) {
+				break;
+			}
+
+			if (channel == 1) {
+				Armband& armband = armbands[orientation.armband[o]];
+				armband.orientation = scaleOrientation(orientation.x[o], orientation.y[o], orientation.z[o],
+					orientation.w[o], settings.fastEuler);
+				recognize(armband, orientation.armband[o], RecognitionSample::sampleOrientation, orientation.timestamp[o],
+					0);
+				++o;
+			}
+			else if (channel == 2) {
+				// Like DataCollector::onGyroscopeData(), only fusion hands the gyroscope to recognition.
+				if (settings.fusion) {
+					float rates[3] = { gyroscope.x[g], gyroscope.y[g], gyroscope.z[g] };
+					recognize(armbands[gyroscope.armband[g]], gyroscope.armband[g], RecognitionSample::sampleGyroscope,
+						gyroscope.timestamp[g], rates);
+				}
+				++g;
+			}
+			else if (channel == 3) {
+				// Like DataCollector::onPose(), repeats of the current pose are dropped.
+				Armband& armband = armbands[pose.armband[p]];
+				if (takePoseChange(armband.pose, pose.type[p])) {
+					recognize(armband, pose.armband[p], RecognitionSample::samplePose, pose.timestamp[p], 0);
+				}
+				++p;
+			}
+			else if (channel == 4) {
+				armbands[arm.armband[a]].onArm = arm.synced[a] != 0;
+				++a;
+			}
+			else {
+				// Like DataCollector::onUnpair(), the slot starts over.
+				Armband& armband = armbands[unpair.armband[u]];
+				armband.onArm = false;
+				armband.pose = poseUnknown;
+				armband.orientation.roll_w = armband.orientation.pitch_w = armband.orientation.yaw_w = 0;
+				recognize(armband, unpair.armband[u], RecognitionSample::sampleReset, unpair.timestamp[u], 0);
+				armband.lastLetter = unpair.timestamp[u];
+				++u;
+			}
+		}
+		return letters;
+	}
+
+private:
+	static const uint32_t noEvent = 0xffffffff;
+
+	struct Armband {
+		Armband()
+			: onArm(false), pose(poseUnknown), lastLetter(0)
+		{
+			orientation.roll_w = orientation.pitch_w = orientation.yaw_w = 0;
+		}
+
+		bool onArm;
+		uint16_t pose;
+		ScaledOrientation orientation;
+		BasicRecognizer<Classifier> recognizer;
+		WordPredictor predictor;
+		uint64_t lastLetter;
+	};
+
+	// recognize() hands an event to the armband's recognizer. `rates` is the angular velocity, for gyroscope events.
+	void recognize(Armband& armband, uint8_t index, RecognitionSample::Kind kind, uint64_t timestamp,
+		const float* rates)
+	{
+		RecognitionSample sample = RecognitionSample();
+		sample.kind = static_cast<uint8_t>(kind);
+		sample.armband = index;
+		sample.onArm = armband.onArm;
+		sample.pose = armband.pose;
+		sample.timestamp = timestamp;
+		sample.roll_w = armband.orientation.roll_w;
+		sample.pitch_w = armband.orientation.pitch_w;
+		sample.yaw_w = armband.orientation.yaw_w;
+		if (rates) {
+			std::memcpy(sample.rates, rates, sizeof(sample.rates));
+		}
+
+		BasicRecognizer<Classifier>& recognizer = armband.recognizer;
+		unsigned code = recognizer.strokes.code();
+		unsigned length = recognizer.word.size();
+		recognizeSample(recognizer, armband.predictor, sample);
+
+		if (recognizer.word.size() > length) {
+			letters.armband.push_back(index);
+			letters.start.push_back(armband.lastLetter);
+			letters.end.push_back(timestamp);
+			letters.code.push_back(static_cast<uint16_t>(code));
+			letters.letter.push_back(static_cast<uint8_t>(recognizer.word.c_str()[length]));
+			armband.lastLetter = timestamp;
+			// The word is emptied whenever it fills up, so long sessions keep decoding.
+			if (recognizer.word.size() == BasicRecognizer<Classifier>::wordCapacity) {
+				recognizer.word.clear();
+			}
+		}
+		else if (recognizer.word.size() < length) {
+			armband.lastLetter = timestamp;
+		}
+	}
+
+	const SessionDataset& dataset;
+	DecoderSettings settings;
+	std::vector<Armband> armbands;
+	SessionDataset::Letters letters;
+};
+
+// labelSession() reads a session and labels it with the letters the recognizer this application uses by default
+// decodes from it.
+inline SessionDataset labelSession(const std::string& path)
+{
+	SessionDataset dataset = readSessionChannels(path);
+	dataset.letters = DatasetDecoder<AxisPeakClassifier>(dataset, DecoderSettings()).decode();
+	return dataset;
+}
+
+// DatasetScore compares the letters a policy decoded from a dataset with its labels. A decoded letter matches a label
+// when it is on the same armband and entered by the same event.
+struct DatasetScore {
+	DatasetScore()
+		: labels(0), correct(0), substituted(0), missed(0), inserted(0)
+	{
+	}
+
+	DatasetScore& operator+=(const DatasetScore& other)
+	{
+		labels += other.labels;
+		correct += other.correct;
+		substituted += other.substituted;
+		missed += other.missed;
+		inserted += other.inserted;
+		return *this;
+	}
+
+	double accuracy() const
+	{
+		return labels ? double(correct) / labels : 0;
+	}
+
+	unsigned long long labels, correct, substituted, missed, inserted;
+};
+
+inline DatasetScore scoreLetters(const SessionDataset::Letters& labels, const SessionDataset::Letters& decoded)
+{
+	// Letters are in the order they were entered, so both lists are sorted by end time and can be merged.
+	DatasetScore score;
+	score.labels = labels.end.size();
+	size_t l = 0, d = 0;
+	while (l < labels.end.size() || d < decoded.end.size()) {
+		bool takeLabel = d == decoded.end.size()
+			|| (l < labels.end.size() && (labels.end[l] < decoded.end[d]
+			|| (labels.end[l] == decoded.end[d] && labels.armband[l] < decoded.armband[d])));
+		bool takeDecoded = l == labels.end.size()
+			|| (d < decoded.end.size() && (decoded.end[d] < labels.end[l]
+			|| (decoded.end[d] == labels.end[l] && decoded.armband[d] < labels.armband[l])));
+		if (takeLabel) {
+			++score.missed;
+			++l;
+		}
+		else if (takeDecoded) {
+			++score.inserted;
+			++d;
+		}
+		else {
+			++(labels.letter[l] == decoded.letter[d] ? score.correct : score.substituted);
+			++l;
+			++d;
+		}
+	}
+	return score;
+}
+
+// evaluateDataset() decodes a dataset with a policy and scores it against the dataset's labels.
+template<typename Classifier>
+DatasetScore evaluateDataset(const SessionDataset& dataset, const DecoderSettings& settings)
+{
+	return scoreLetters(dataset.letters, DatasetDecoder<Classifier>(dataset, settings).decode());
+}
+
+// DatasetLayout is the visitor that lays the columns out in order and describes them.
+class DatasetLayout {
+public:
+	template<typename T>
+	void operator()(const char* name, std::vector<T>& values)
+	{
+		DatasetColumn column;
+		std::memset(&column, 0, sizeof(column));
+		std::strncpy(column.name, name, sizeof(column.name) - 1);
+		column.type = DatasetColumnTypeOf<T>::value;
+		column.count = values.size();
+		columns.push_back(column);
+		sizes.push_back(values.size() * sizeof(T));
+		data.push_back(values.empty() ? 0 : reinterpret_cast<const char*>(&values[0]));
+	}
+
+	std::vector<DatasetColumn> columns;
+	std::vector<uint64_t> sizes;
+	std::vector<const char*> data;
+};
+
+// writeDataset() writes a dataset file. It throws std::runtime_error on I/O errors.
+inline void writeDataset(SessionDataset& dataset, const std::string& path)
+{
+	DatasetLayout layout;
+	dataset.visitColumns(layout);
+
+	DatasetHeader header;
+	std::memcpy(header.magic, datasetMagic, sizeof(header.magic));
+	header.version = datasetVersion;
+	header.columnCount = static_cast<uint32_t>(layout.columns.size());
+	uint64_t offset = sizeof(header) + layout.columns.size() * sizeof(DatasetColumn);
+	for (size_t i = 0; i < layout.columns.size(); ++i) {
+		offset = (offset + 7) & ~uint64_t(7);
+		layout.columns[i].offset = offset;
+		offset += layout.sizes[i];
+	}
+
+	std::ofstream output(path.c_str(), std::ios::binary | std::ios::trunc);
+	output.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	output.write(reinterpret_cast<const char*>(&layout.columns[0]), layout.columns.size() * sizeof(DatasetColumn));
+	uint64_t written = sizeof(header) + layout.columns.size() * sizeof(DatasetColumn);
+	const char padding[8] = {};
+	for (size_t i = 0; i < layout.columns.size(); ++i) {
+		output.write(padding, layout.columns[i].offset - written);
+		output.write(layout.data[i], layout.sizes[i]);
+		written = layout.columns[i].offset + layout.sizes[i];
+	}
+	if (!output) {
+		throw std::runtime_error("Unable to write dataset " + path);
+	}
+}
+
+// DatasetReader is the visitor that fills columns from a mapped dataset file. Columns the file doesn't have stay
+// empty, so a file written with fewer columns can still be read.
+class DatasetReader {
+public:
+	DatasetReader(const MappedFile& file, const std::string& path)
+		: file(file), path(path)
+	{
+		DatasetHeader header;
+		if (file.size() < sizeof(header)) {
+			throw std::runtime_error(path + " is not a dataset file");
+		}
+		std::memcpy(&header, file.data(), sizeof(header));
+		if (std::memcmp(header.magic, datasetMagic, sizeof(header.magic)) != 0 || header.version != datasetVersion
+			|| file.size() < sizeof(header) + uint64_t(header.columnCount) * sizeof(DatasetColumn)) {
+			throw std::runtime_error(path + " is not a dataset file this version can read");
+		}
+		columns.resize(header.columnCount);
+		if (header.columnCount) {
+			std::memcpy(&columns[0], file.data() + sizeof(header), header.columnCount * sizeof(DatasetColumn));
+		}
+	}
+
+	template<typename T>
+	void operator()(const char* name, std::vector<T>& values)
+	{
+		for (size_t i = 0; i < columns.size(); ++i) {
+			const DatasetColumn& column = columns[i];
+			if (std::strncmp(column.name, name, sizeof(column.name)) != 0) {
+				continue;
+			}
+			if (column.type != DatasetColumnTypeOf<T>::value || column.offset > file.size()
+				|| column.count > (file.size() - column.offset) / sizeof(T)) {
+				throw std::runtime_error(path + " has a malformed column " + name);
+			}
+			values.resize(static_cast<size_t>(column.count));
+			if (!values.empty()) {
+				std::memcpy(&values[0], file.data() + column.offset, values.size() * sizeof(T));
+			}
+			return;
+		}
+	}
+
+private:
+	const MappedFile& file;
+	std::string path;
+	std::vector<DatasetColumn> columns;
+};
+
+// readDataset() reads a dataset file. It throws std::runtime_error if the file is missing or malformed.
+inline SessionDataset readDataset(const std::string& path)
+{
+	MappedFile file(path);
+	DatasetReader reader(file, path);
+	SessionDataset dataset;
+	dataset.visitColumns(reader);
+	return dataset;
+}
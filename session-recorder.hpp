@@ -0,0 +1,208 @@
+// Recording of raw Myo events to a compact binary file, so sessions can be inspected and replayed later.
+#pragma once
+
+#include <condition_variable>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <stdint.h>
+#include <string>
+#include <thread>
+
+// A session file starts with a SessionHeader followed by nothing but SessionRecords, in the order the events arrived.
+// Both are written in the host's (little-endian) byte order.
+enum SessionRecordType {
+	recordPair = 1,
+	recordUnpair,
+	recordOrientation,
+	recordPose,
+	recordArmSync,
+	recordArmUnsync,
+	recordUnlock,
+	recordLock,
+	recordEmg,
+	recordGyroscope
+};
+
+struct SessionHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t recordSize;
+};
+
+// Every event is stored as one fixed-size record. What `code`, `extra` and `values` hold depends on the type:
+//  - recordOrientation: values are the quaternion x, y, z, w.
+//  - recordPose: code is the myo::Pose::Type.
+//  - recordArmSync: code is the myo::Arm, extra is the myo::XDirection, values[0] is the rotation and values[1] is
+//    the myo::WarmupState.
+//  - recordEmg: values[0] and values[1] hold the eight int8_t EMG samples, in channel order.
+//  - recordGyroscope: values are the angular velocity about x, y and z in degrees per second.
+// The other types carry nothing beyond the timestamp and armband.
+struct SessionRecord {
+	uint64_t timestamp;
+	uint8_t type;
+	uint8_t armband;
+	uint16_t code;
+	uint32_t extra;
+	float values[4];
+};
+
+static_assert(sizeof(SessionRecord) == 32, "session records must keep their on-disk size");
+
+const char sessionMagic[8] = { 'M', 'Y', 'O', 'S', 'E', 'S', 'S', '\0' };
+const uint32_t sessionVersion = 1;
+
+// makeSessionRecord() returns a record with every field but the type, armband and timestamp cleared.
+inline SessionRecord makeSessionRecord(SessionRecordType type, unsigned armband, uint64_t timestamp)
+{
+	SessionRecord record;
+	std::memset(&record, 0, sizeof(record));
+	record.timestamp = timestamp;
+	record.type = static_cast<uint8_t>(type);
+	record.armband = static_cast<uint8_t>(armband);
+	return record;
+}
+
+// SessionRecorder appends records to a session file. record() only copies the record into the active buffer; when that
+// buffer fills up, or holds more than a second of events, it is handed to a writer thread and recording continues in
+// the other buffer. If the writer is still busy with the previous buffer the new one is discarded and counted in
+// dropped(), so recording never blocks the thread calling record().
+//
+// Records of different armbands may arrive slightly out of timestamp order, so a record older than the first in the
+// buffer never counts towards the second.
+class SessionRecorder {
+public:
+	static const unsigned bufferRecords = 1024;
+	static const uint64_t flushInterval = 1000000;
+
+	explicit SessionRecorder(const std::string& path)
+		: path(path), file(path.c_str(), std::ios::binary | std::ios::trunc), active(0), fill(0), pending(false), pendingIndex(0),
+		pendingCount(0), droppedRecords(0), droppedBuffers(0), stopping(false)
+	{
+		if (!file) {
+			throw std::runtime_error("Unable to open session file " + path);
+		}
+
+		SessionHeader header;
+		std::memcpy(header.magic, sessionMagic, sizeof(header.magic));
+		header.version = sessionVersion;
+		header.recordSize = sizeof(SessionRecord);
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+		buffers[0].reset(new SessionRecord[bufferRecords]);
+		buffers[1].reset(new SessionRecord[bufferRecords]);
+		writer = std::thread(&SessionRecorder::run, this);
+	}
+
+	// The destructor writes out everything recorded so far before closing the file, and reports on std::cerr how many
+	// records were dropped, if any.
+	~SessionRecorder()
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		idle.wait(lock, [this] { return !pending; });
+		if (fill > 0) {
+			queueActive();
+		}
+		stopping = true;
+		lock.unlock();
+		wake.notify_one();
+		writer.join();
+		if (droppedRecords > 0) {
+			std::cerr << "Session file " << path << ": dropped " << droppedRecords << " records in "
+				<< droppedBuffers << " buffers because writing couldn't keep up" << std::endl;
+		}
+	}
+
+	// record() must always be called from the same thread, normally the one calling Hub::run().
+	void record(const SessionRecord& record)
+	{
+		SessionRecord* buffer = buffers[active].get();
+		buffer[fill++] = record;
+		if (fill == bufferRecords
+			|| (record.timestamp > buffer[0].timestamp && record.timestamp - buffer[0].timestamp >= flushInterval)) {
+			handOff();
+		}
+	}
+
+	// dropped() returns how many records were discarded because the writer couldn't keep up.
+	unsigned dropped() const
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		return droppedRecords;
+	}
+
+private:
+	SessionRecorder(const SessionRecorder&);
+	SessionRecorder& operator=(const SessionRecorder&);
+
+	void handOff()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (pending) {
+				droppedRecords += fill;
+				++droppedBuffers;
+				fill = 0;
+				return;
+			}
+			queueActive();
+		}
+		wake.notify_one();
+	}
+
+	// queueActive() passes the active buffer to the writer and switches to the other one. The lock must be held.
+	void queueActive()
+	{
+		pending = true;
+		pendingIndex = active;
+		pendingCount = fill;
+		active ^= 1;
+		fill = 0;
+	}
+
+	void run()
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		for (;;) {
+			wake.wait(lock, [this] { return pending || stopping; });
+			if (!pending) {
+				return;
+			}
+
+			const SessionRecord* buffer = buffers[pendingIndex].get();
+			unsigned count = pendingCount;
+			lock.unlock();
+			file.write(reinterpret_cast<const char*>(buffer), count * sizeof(SessionRecord));
+			file.flush();
+			lock.lock();
+
+			pending = false;
+			idle.notify_all();
+		}
+	}
+
+	std::string path;
+	std::ofstream file;
+
+	// The buffer record() appends to and how many records it holds. Only the recording thread touches these, apart
+	// from the destructor.
+	std::unique_ptr<SessionRecord[]> buffers[2];
+	unsigned active;
+	unsigned fill;
+
+	// The buffer handed to the writer, if any.
+	bool pending;
+	unsigned pendingIndex;
+	unsigned pendingCount;
+
+	unsigned droppedRecords;
+	unsigned droppedBuffers;
+	bool stopping;
+	mutable std::mutex mutex;
+	std::condition_variable wake;
+	std::condition_variable idle;
+	std::thread writer;
+};
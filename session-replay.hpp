@@ -0,0 +1,118 @@
+// Replay of recorded sessions straight into a DeviceListener, without a Hub or any hardware.
+#pragma once
+
+#include <cstring>
+#include <stdexcept>
+#include <stdint.h>
+#include <string>
+
+#include <myo/myo.hpp>
+
+#include "mapped-file.hpp"
+#include "session-recorder.hpp"
+
+// SessionReplay maps a session file written by SessionRecorder and delivers its events to a listener as fast as the
+// listener can take them. The recorded SDK timestamps are passed through unchanged, so anything that measures time
+// by event timestamps (like Recognizer's cooldowns) sees the same clock it saw live.
+//
+// The listener is handed stand-in myo::Myo pointers, one per recorded armband slot. They identify the armband but
+// are not real devices, so the listener must not call any methods on them (see DataCollector::commandDevices).
+class SessionReplay {
+public:
+	explicit SessionReplay(const std::string& path)
+		: file(path)
+	{
+		SessionHeader header;
+		if (file.size() < sizeof(header)) {
+			throw std::runtime_error(path + " is not a session file");
+		}
+		std::memcpy(&header, file.data(), sizeof(header));
+		if (std::memcmp(header.magic, sessionMagic, sizeof(header.magic)) != 0 || header.version != sessionVersion
+			|| header.recordSize != sizeof(SessionRecord)) {
+			throw std::runtime_error(path + " is not a session file this version can read");
+		}
+	}
+
+	size_t recordCount() const
+	{
+		return (file.size() - sizeof(SessionHeader)) / sizeof(SessionRecord);
+	}
+
+	// record() returns the i-th record. Records are copied out because the mapping gives no alignment guarantee
+	// beyond the header size.
+	SessionRecord record(size_t i) const
+	{
+		SessionRecord result;
+		std::memcpy(&result, file.data() + sizeof(SessionHeader) + i * sizeof(SessionRecord), sizeof(result));
+		return result;
+	}
+
+	// run() delivers every record to the listener in the order it was recorded.
+	void run(myo::DeviceListener& listener) const
+	{
+		size_t count = recordCount();
+		for (size_t i = 0; i < count; ++i) {
+			deliver(listener, record(i));
+		}
+	}
+
+	myo::Myo* deviceFor(unsigned armband) const
+	{
+		return reinterpret_cast<myo::Myo*>(const_cast<char*>(&devices[armband]));
+	}
+
+private:
+	void deliver(myo::DeviceListener& listener, const SessionRecord& record) const
+	{
+		myo::Myo* device = deviceFor(record.armband);
+		switch (record.type) {
+		case recordPair: {
+			myo::FirmwareVersion version = { 0, 0, 0, 0 };
+			listener.onPair(device, record.timestamp, version);
+			break;
+		}
+		case recordUnpair:
+			listener.onUnpair(device, record.timestamp);
+			break;
+		case recordOrientation:
+			listener.onOrientationData(device, record.timestamp,
+				myo::Quaternion<float>(record.values[0], record.values[1], record.values[2], record.values[3]));
+			break;
+		case recordPose:
+			listener.onPose(device, record.timestamp, myo::Pose(static_cast<myo::Pose::Type>(record.code)));
+			break;
+		case recordArmSync:
+			listener.onArmSync(device, record.timestamp, static_cast<myo::Arm>(record.code),
+				static_cast<myo::XDirection>(record.extra), record.values[0],
+				static_cast<myo::WarmupState>(static_cast<int>(record.values[1])));
+			break;
+		case recordArmUnsync:
+			listener.onArmUnsync(device, record.timestamp);
+			break;
+		case recordUnlock:
+			listener.onUnlock(device, record.timestamp);
+			break;
+		case recordLock:
+			listener.onLock(device, record.timestamp);
+			break;
+		case recordEmg: {
+			int8_t emg[8];
+			std::memcpy(emg, record.values, sizeof(emg));
+			listener.onEmgData(device, record.timestamp, emg);
+			break;
+		}
+		case recordGyroscope:
+			listener.onGyroscopeData(device, record.timestamp,
+				myo::Vector3<float>(record.values[0], record.values[1], record.values[2]));
+			break;
+		default:
+			// Records of types this version doesn't know about are skipped.
+			break;
+		}
+	}
+
+	MappedFile file;
+
+	// Only the addresses of these are used, as the stand-in myo::Myo pointers.
+	char devices[256];
+};
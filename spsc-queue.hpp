@@ -0,0 +1,72 @@
+// A bounded, lock-free queue for one producer thread and one consumer thread.
+#pragma once
+
+#include <atomic>
+
+// SpscQueue stores up to Capacity values in a ring. push() may only be called from one thread and pop() from one
+// other thread; neither ever blocks or takes a lock. head and tail live on separate cache lines so the two threads
+// don't keep invalidating each other's copy.
+template<typename T, unsigned Capacity>
+class SpscQueue {
+	static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0, "SpscQueue capacity must be a power of two");
+
+public:
+	SpscQueue()
+		: head(0), tail(0)
+	{
+	}
+
+	// push() appends a value and returns true, or returns false without touching the queue if it is full.
+	bool push(const T& value)
+	{
+		unsigned back = tail.load(std::memory_order_relaxed);
+		if (back - head.load(std::memory_order_acquire) == Capacity) {
+			return false;
+		}
+		slots[back & (Capacity - 1)] = value;
+		tail.store(back + 1, std::memory_order_release);
+		return true;
+	}
+
+	// pop() removes the oldest value into `value` and returns true, or returns false if the queue is empty.
+	bool pop(T& value)
+	{
+		unsigned front = head.load(std::memory_order_relaxed);
+		if (front == tail.load(std::memory_order_acquire)) {
+			return false;
+		}
+		value = slots[front & (Capacity - 1)];
+		head.store(front + 1, std::memory_order_release);
+		return true;
+	}
+
+	// peek() points `first` at the oldest value and returns how many values follow it contiguously in the ring, so the
+	// consumer can use them in place. consume() then removes the first `count` of them. Like pop(), they may only be
+	// called from the consumer thread.
+	unsigned peek(const T*& first) const
+	{
+		unsigned front = head.load(std::memory_order_relaxed);
+		unsigned available = tail.load(std::memory_order_acquire) - front;
+		unsigned offset = front & (Capacity - 1);
+		first = slots + offset;
+		return available < Capacity - offset ? available : Capacity - offset;
+	}
+
+	void consume(unsigned count)
+	{
+		head.store(head.load(std::memory_order_relaxed) + count, std::memory_order_release);
+	}
+
+	bool empty() const
+	{
+		return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire);
+	}
+
+private:
+	SpscQueue(const SpscQueue&);
+	SpscQueue& operator=(const SpscQueue&);
+
+	alignas(64) std::atomic<unsigned> head;
+	alignas(64) std::atomic<unsigned> tail;
+	alignas(64) T slots[Capacity];
+};
@@ -0,0 +1,148 @@
+// Stroke classification strategies for BasicRecognizer.
+#pragma once
+
+#include <cmath>
+#include <ostream>
+
+#include "letter-table.hpp"
+
+// A stroke classifier decides which axis a stroke was made about, and which way. BasicRecognizer calls, for each
+// stroke:
+//  - reset() when the stroke begins (and whenever a new home position is set),
+//  - observe() with the offset from home of every orientation sample while the arm is away from home,
+//  - classify() once the arm is back home, returning strokeNone if it can't tell,
+//  - describe() to print what it saw, when the recognizer is verbose.
+// Classifiers are template parameters rather than virtual interfaces, so with any of them the per-sample path is
+// inlined into the recognizer.
+
+// unwrapOffset() takes the shorter way round for a roll or yaw offset from home, since those wrap around at 18 on the
+// orientation scale.
+inline float unwrapOffset(float offset)
+{
+	return offset > 9 ? offset - 18 : offset < -9 ? offset + 18 : offset;
+}
+
+// AxisPeakClassifier picks the axis whose offset from home peaked highest, in the direction of that peak. A yaw offset
+// of exactly 17 is ignored, since it shows up when yaw wraps around rather than when the arm turns.
+class AxisPeakClassifier {
+public:
+	AxisPeakClassifier()
+	{
+		reset();
+	}
+
+	void reset()
+	{
+		max_roll = 0;
+		max_yaw = 0;
+		max_pitch = 0;
+		peak_roll = 0;
+		peak_yaw = 0;
+		peak_pitch = 0;
+	}
+
+	void observe(float roll, float pitch, float yaw)
+	{
+		if (std::abs(roll) > max_roll) {
+			max_roll = std::abs(roll);
+			peak_roll = unwrapOffset(roll);
+		}
+		if (std::abs(yaw) > max_yaw && std::abs(yaw) != 17) {
+			max_yaw = std::abs(yaw);
+			peak_yaw = unwrapOffset(yaw);
+		}
+		if (std::abs(pitch) > max_pitch) {
+			max_pitch = std::abs(pitch);
+			peak_pitch = pitch;
+		}
+	}
+
+	Stroke classify() const
+	{
+		Stroke stroke = strokeNone;
+		if (max_yaw > max_roll && max_yaw > max_pitch) {
+			stroke = directedStroke(strokeYaw, peak_yaw);
+		}
+		if (max_roll > max_yaw && max_roll > max_pitch) {
+			stroke = directedStroke(strokeRoll, peak_roll);
+		}
+		if (max_pitch > max_roll && max_pitch > max_yaw) {
+			stroke = directedStroke(strokePitch, peak_pitch);
+		}
+		return stroke;
+	}
+
+	void describe(std::ostream& out) const
+	{
+		out << max_roll << '\n' << max_pitch << '\n' << max_yaw << '\n';
+	}
+
+	float max_roll, max_yaw, max_pitch;
+	// The offsets at which the peaks were reached, which give the stroke's direction.
+	float peak_roll, peak_yaw, peak_pitch;
+};
+
+// PathLengthClassifier picks the axis along which the arm travelled furthest, summing how much the offset changed
+// between samples. A stroke out and back covers twice its peak on its own axis, while a brief overshoot on another
+// axis counts for little, which makes it steadier than the peak for wobbly strokes. The direction is that of the
+// offset furthest from home on the axis.
+class PathLengthClassifier {
+public:
+	PathLengthClassifier()
+	{
+		reset();
+	}
+
+	void reset()
+	{
+		for (unsigned i = 0; i < 3; ++i) {
+			last[i] = 0;
+			travelled[i] = 0;
+			furthest[i] = 0;
+		}
+	}
+
+	void observe(float roll, float pitch, float yaw)
+	{
+		const float offsets[3] = { roll, pitch, yaw };
+		for (unsigned i = 0; i < 3; ++i) {
+			float step = std::abs(offsets[i] - last[i]);
+			// Yaw wrapping around from 0 to 18 looks like a huge step; it isn't movement.
+			if (step < 9) {
+				travelled[i] += step;
+			}
+			last[i] = offsets[i];
+			float offset = i == 1 ? offsets[i] : unwrapOffset(offsets[i]);
+			if (std::abs(offset) > std::abs(furthest[i])) {
+				furthest[i] = offset;
+			}
+		}
+	}
+
+	Stroke classify() const
+	{
+		static const Stroke axes[3] = { strokeRoll, strokePitch, strokeYaw };
+		unsigned best = 0;
+		for (unsigned i = 1; i < 3; ++i) {
+			if (travelled[i] > travelled[best]) {
+				best = i;
+			}
+		}
+		for (unsigned i = 0; i < 3; ++i) {
+			if (i != best && travelled[i] == travelled[best]) {
+				return strokeNone;
+			}
+		}
+		return directedStroke(axes[best], furthest[best]);
+	}
+
+	void describe(std::ostream& out) const
+	{
+		out << travelled[0] << '\n' << travelled[1] << '\n' << travelled[2] << '\n';
+	}
+
+private:
+	float last[3];
+	float travelled[3];
+	float furthest[3];
+};
@@ -0,0 +1,75 @@
+"""Subscribes to the telemetry that hello-myo publishes with --telemetry and prints the events as they arrive.
+
+Usage: python telemetry-client.py [--token <token>] [<address>:]<port>
+
+The address is 127.0.0.1 unless given, like hello-myo's own. The frame layout is described in telemetry-server.hpp.
+"""
+import socket
+import struct
+import sys
+import time
+
+# The size every request is padded to: a frame header and 50 events, see TelemetryServer::requestLength.
+REQUEST_LENGTH = 16 + 50 * 24
+RESUBSCRIBE_SECONDS = 3
+
+HEADER = struct.Struct('<4sHHII')
+EVENT = struct.Struct('<QBBH3f')
+EVENT_NAMES = {1: 'orientation', 2: 'pose', 3: 'letter'}
+
+
+def request(verb, token):
+    text = verb + (' ' + token if token else '')
+    return text.encode('ascii').ljust(REQUEST_LENGTH, b' ')
+
+
+def describe(event):
+    timestamp, kind, armband, code, roll, pitch, yaw = event
+    name = EVENT_NAMES.get(kind, 'type %d' % kind)
+    if kind == 1:
+        detail = 'roll %.0f pitch %.0f yaw %.0f' % (roll, pitch, yaw)
+    elif kind == 3:
+        detail = repr(chr(code))
+    else:
+        detail = str(code)
+    return '%d armband %d %s %s' % (timestamp, armband, name, detail)
+
+
+def main(arguments):
+    token = ''
+    if len(arguments) == 3 and arguments[0] == '--token':
+        token = arguments[1]
+        arguments = arguments[2:]
+    if len(arguments) != 1:
+        sys.stderr.write(__doc__)
+        return 1
+    address, _, port = arguments[0].rpartition(':')
+    server = (address or '127.0.0.1', int(port))
+
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    sock.settimeout(RESUBSCRIBE_SECONDS)
+    sequence = None
+    try:
+        while True:
+            sock.sendto(request('subscribe', token), server)
+            deadline = time.time() + RESUBSCRIBE_SECONDS
+            while time.time() < deadline:
+                try:
+                    datagram = sock.recv(65536)
+                except socket.timeout:
+                    break
+                magic, version, count, number, dropped = HEADER.unpack_from(datagram)
+                if magic != b'MYOT' or len(datagram) != HEADER.size + count * EVENT.size:
+                    continue
+                if sequence is not None and number != (sequence + 1) & 0xffffffff:
+                    print('lost %d datagrams' % ((number - sequence - 1) & 0xffffffff))
+                sequence = number
+                for i in range(count):
+                    print(describe(EVENT.unpack_from(datagram, HEADER.size + i * EVENT.size)))
+    except KeyboardInterrupt:
+        sock.sendto(request('unsubscribe', token), server)
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main(sys.argv[1:]))
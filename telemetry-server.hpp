@@ -0,0 +1,390 @@
+// A UDP server that streams armband events to dashboards and other remote subscribers.
+#pragma once
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <stdint.h>
+#include <string>
+#include <thread>
+
+#include "spsc-queue.hpp"
+
+// Every datagram is a TelemetryFrameHeader followed by eventCount TelemetryEvents, in the host's (little-endian) byte
+// order. What an event's `code` and `values` hold depends on its type:
+//  - telemetryOrientation: values are roll, pitch and yaw on the 0 to 18 scale, after filtering.
+//  - telemetryPose: code is the myo::Pose::Type.
+//  - telemetryLetter: code is the letter (or space) appended to the armband's word.
+// `sequence` counts datagrams, so a subscriber can tell when some were lost on the way, and `dropped` counts the
+// events that never made it into a datagram because the server fell behind.
+enum TelemetryEventType {
+	telemetryOrientation = 1,
+	telemetryPose,
+	telemetryLetter
+};
+
+struct TelemetryFrameHeader {
+	char magic[4];
+	uint16_t version;
+	uint16_t eventCount;
+	uint32_t sequence;
+	uint32_t dropped;
+};
+
+struct TelemetryEvent {
+	uint64_t timestamp;
+	uint8_t type;
+	uint8_t armband;
+	uint16_t code;
+	float values[3];
+};
+
+static_assert(sizeof(TelemetryFrameHeader) == 16 && sizeof(TelemetryEvent) == 24,
+	"telemetry frames must keep their layout");
+
+const char telemetryMagic[4] = { 'M', 'Y', 'O', 'T' };
+const uint16_t telemetryVersion = 1;
+
+// TelemetryServer sends batches of events to everyone who has subscribed. A subscriber is whoever sent the server a
+// datagram of "subscribe" followed by a space and the server's token, padded to at least requestLength bytes, and
+// stays one for subscriptionTimeout after the last such datagram, so clients should resubscribe every few seconds.
+// "unsubscribe" and the token end a subscription at once. Requests that are too short or carry the wrong token are
+// ignored without a reply.
+//
+// The events include every letter typed, and UDP sources are easy to forge, so the server listens on the loopback
+// interface unless told otherwise, and only listens anywhere else with a token for subscribers to prove they were
+// given. The padding keeps a forged request no smaller than any datagram it gets sent.
+// telemetry-client.py is a subscriber to start from.
+//
+// publish() only appends the event to a ring; there is one ring per publishing thread, since each ring takes a single
+// producer. A sender thread wakes every tick, and sends what the rings hold straight out of the ring slots, behind a
+// frame header, without copying the events. The socket never blocks: a subscriber whose datagrams can't be sent
+// maxFailures times in a row is dropped, and if the sender falls behind altogether publish() drops events rather than
+// wait, so the thread running the Hub is never held up by the network. The constructor throws std::runtime_error if
+// the address or token won't do or the port can't be opened.
+class TelemetryServer {
+public:
+	// The threads that publish: the one running the Hub, and the recognition thread in pipeline mode (or the Hub's
+	// thread again without it).
+	enum Source {
+		sourceEvents,
+		sourceRecognition,
+		sourceCount
+	};
+
+	static const unsigned ringCapacity = 4096;
+	static const unsigned maxSubscribers = 8;
+	static const unsigned maxFailures = 8;
+	// 50 events make a datagram of 1216 bytes, which fits an Ethernet frame without fragmenting.
+	static const unsigned maxBatch = 50;
+	static const unsigned tickMilliseconds = 20;
+	static const unsigned subscriptionTimeout = 10000;
+	// Requests are padded to the size of the largest datagram.
+	static const unsigned requestLength = sizeof(TelemetryFrameHeader) + maxBatch * sizeof(TelemetryEvent);
+
+	// The server listens on `address`, a dotted IPv4 address; with any but a loopback one it needs a token.
+	TelemetryServer(const std::string& address, unsigned short port, const std::string& token)
+		: socket(invalidSocket), token(token), sequence(0), dropped(0), stopping(false), clientCount(0),
+		subscriberCount(0)
+	{
+		if (std::string("unsubscribe ").size() + token.size() > requestLength) {
+			throw std::runtime_error("The telemetry token is too long");
+		}
+#ifdef _WIN32
+		WSADATA winsock;
+		if (WSAStartup(MAKEWORD(2, 2), &winsock) != 0) {
+			throw std::runtime_error("Unable to start Winsock");
+		}
+#endif
+		sockaddr_in local;
+		std::memset(&local, 0, sizeof(local));
+		local.sin_family = AF_INET;
+		local.sin_port = htons(port);
+		if (inet_pton(AF_INET, address.c_str(), &local.sin_addr) != 1) {
+			closeSocket();
+			throw std::runtime_error("Invalid telemetry address " + address);
+		}
+		if ((ntohl(local.sin_addr.s_addr) >> 24) != 127 && token.empty()) {
+			closeSocket();
+			throw std::runtime_error("Telemetry on " + address + " needs a token for subscribers");
+		}
+
+		socket = ::socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+		if (socket == invalidSocket || ::bind(socket, reinterpret_cast<sockaddr*>(&local), sizeof(local)) != 0
+			|| !makeNonBlocking()) {
+			closeSocket();
+			throw std::runtime_error("Unable to open the telemetry port " + address + ":" + std::to_string(port));
+		}
+
+		// The rings are placed by hand because plain new doesn't honour the cache line alignment SpscQueue asks for
+		// before C++17.
+		ringMemory.reset(new char[sizeof(Rings) + alignof(Rings)]);
+		uintptr_t ringAddress = reinterpret_cast<uintptr_t>(ringMemory.get());
+		ringAddress = (ringAddress + alignof(Rings) - 1) & ~uintptr_t(alignof(Rings) - 1);
+		rings = new (reinterpret_cast<void*>(ringAddress)) Rings();
+
+		sender = std::thread(&TelemetryServer::run, this);
+	}
+
+	~TelemetryServer()
+	{
+		stopping = true;
+		sender.join();
+		closeSocket();
+		rings->~Rings();
+	}
+
+	// publish() queues an event for the subscribers. Each source may only be used from one thread at a time.
+	void publish(Source source, const TelemetryEvent& event)
+	{
+		if (!rings->queues[source].push(event)) {
+			dropped.fetch_add(1, std::memory_order_relaxed);
+		}
+	}
+
+	// subscribers() is how many subscribers there were at the last tick.
+	unsigned subscribers() const
+	{
+		return subscriberCount.load(std::memory_order_relaxed);
+	}
+
+private:
+#ifdef _WIN32
+	typedef SOCKET Socket;
+	static const Socket invalidSocket = INVALID_SOCKET;
+#else
+	typedef int Socket;
+	static const Socket invalidSocket = -1;
+#endif
+
+	struct Rings {
+		SpscQueue<TelemetryEvent, ringCapacity> queues[sourceCount];
+	};
+
+	struct Subscriber {
+		sockaddr_in address;
+		std::chrono::steady_clock::time_point lastHeard;
+		unsigned failures;
+	};
+
+	bool makeNonBlocking()
+	{
+#ifdef _WIN32
+		u_long on = 1;
+		return ioctlsocket(socket, FIONBIO, &on) == 0;
+#else
+		int flags = fcntl(socket, F_GETFL, 0);
+		return flags >= 0 && fcntl(socket, F_SETFL, flags | O_NONBLOCK) == 0;
+#endif
+	}
+
+	void closeSocket()
+	{
+		if (socket != invalidSocket) {
+#ifdef _WIN32
+			closesocket(socket);
+#else
+			close(socket);
+#endif
+			socket = invalidSocket;
+		}
+#ifdef _WIN32
+		WSACleanup();
+#endif
+	}
+
+	// run() is the body of the sender thread. Between ticks it waits for subscription requests.
+	void run()
+	{
+		std::chrono::steady_clock::time_point nextTick = std::chrono::steady_clock::now();
+		while (!stopping) {
+			std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+			if (now >= nextTick) {
+				expireSubscribers(now);
+				for (unsigned source = 0; source < sourceCount; ++source) {
+					sendQueued(rings->queues[source]);
+				}
+				nextTick = now + std::chrono::milliseconds(static_cast<int>(tickMilliseconds));
+				continue;
+			}
+
+			long long wait = std::chrono::duration_cast<std::chrono::microseconds>(nextTick - now).count();
+			fd_set readable;
+			FD_ZERO(&readable);
+			FD_SET(socket, &readable);
+			timeval timeout;
+			timeout.tv_sec = 0;
+			timeout.tv_usec = static_cast<long>(wait);
+			if (select(static_cast<int>(socket) + 1, &readable, 0, 0, &timeout) > 0) {
+				receiveRequests();
+			}
+		}
+	}
+
+	// receiveRequests() handles every datagram waiting on the socket.
+	void receiveRequests()
+	{
+		char request[requestLength + 1];
+		sockaddr_in from;
+		for (;;) {
+#ifdef _WIN32
+			int fromLength = sizeof(from);
+#else
+			socklen_t fromLength = sizeof(from);
+#endif
+			int received = static_cast<int>(recvfrom(socket, request, sizeof(request), 0,
+				reinterpret_cast<sockaddr*>(&from), &fromLength));
+			if (received < 0) {
+				return;
+			}
+			if (received < static_cast<int>(requestLength)) {
+				continue;
+			}
+			std::string text(request, received);
+			Subscriber* existing = find(from);
+			if (hasToken(text, 11) && text.compare(0, 11, "unsubscribe") == 0) {
+				if (existing) {
+					*existing = clients[--clientCount];
+				}
+			}
+			else if (hasToken(text, 9) && text.compare(0, 9, "subscribe") == 0) {
+				if (!existing && clientCount < maxSubscribers) {
+					existing = &clients[clientCount++];
+					existing->address = from;
+				}
+				if (existing) {
+					existing->lastHeard = std::chrono::steady_clock::now();
+					existing->failures = 0;
+				}
+			}
+		}
+	}
+
+	// hasToken() checks that the request's verb, `verbLength` characters long, is followed by a space and the token,
+	// and then only padding. It looks at every character of the token either way, so that how long a wrong token
+	// took to turn down says nothing about how much of it was right.
+	bool hasToken(const std::string& request, size_t verbLength) const
+	{
+		size_t start = verbLength + 1;
+		if (request[verbLength] != ' ' || request.size() < start + token.size()) {
+			return false;
+		}
+		unsigned difference = 0;
+		for (size_t i = 0; i < token.size(); ++i) {
+			difference |= static_cast<unsigned char>(request[start + i] ^ token[i]);
+		}
+		size_t end = start + token.size();
+		return difference == 0 && (end == request.size() || request[end] == ' ' || request[end] == '\0');
+	}
+
+	Subscriber* find(const sockaddr_in& address)
+	{
+		for (unsigned i = 0; i < clientCount; ++i) {
+			if (clients[i].address.sin_addr.s_addr == address.sin_addr.s_addr
+				&& clients[i].address.sin_port == address.sin_port) {
+				return &clients[i];
+			}
+		}
+		return 0;
+	}
+
+	void expireSubscribers(std::chrono::steady_clock::time_point now)
+	{
+		for (unsigned i = 0; i < clientCount;) {
+			if (clients[i].failures >= maxFailures
+				|| now - clients[i].lastHeard > std::chrono::milliseconds(static_cast<int>(subscriptionTimeout))) {
+				clients[i] = clients[--clientCount];
+			}
+			else {
+				++i;
+			}
+		}
+		subscriberCount.store(clientCount, std::memory_order_relaxed);
+	}
+
+	// sendQueued() sends everything in a ring, in datagrams of up to maxBatch events that point into the ring itself.
+	// Events are consumed whether or not anyone is subscribed.
+	void sendQueued(SpscQueue<TelemetryEvent, ringCapacity>& queue)
+	{
+		const TelemetryEvent* events;
+		unsigned available;
+		while ((available = queue.peek(events)) > 0) {
+			unsigned batch = available < maxBatch ? available : maxBatch;
+			TelemetryFrameHeader header;
+			std::memcpy(header.magic, telemetryMagic, sizeof(header.magic));
+			header.version = telemetryVersion;
+			header.eventCount = static_cast<uint16_t>(batch);
+			header.sequence = sequence++;
+			header.dropped = static_cast<uint32_t>(dropped.load(std::memory_order_relaxed));
+			for (unsigned i = 0; i < clientCount; ++i) {
+				if (clients[i].failures < maxFailures) {
+					send(clients[i], header, events, batch);
+				}
+			}
+			queue.consume(batch);
+		}
+	}
+
+	// send() gathers the header and the events into one datagram. A datagram the socket won't take right away counts
+	// as a failure for the subscriber.
+	void send(Subscriber& subscriber, const TelemetryFrameHeader& header, const TelemetryEvent* events, unsigned batch)
+	{
+#ifdef _WIN32
+		WSABUF parts[2];
+		parts[0].buf = const_cast<char*>(reinterpret_cast<const char*>(&header));
+		parts[0].len = sizeof(header);
+		parts[1].buf = const_cast<char*>(reinterpret_cast<const char*>(events));
+		parts[1].len = batch * sizeof(TelemetryEvent);
+		DWORD sent = 0;
+		bool ok = WSASendTo(socket, parts, 2, &sent, 0, reinterpret_cast<const sockaddr*>(&subscriber.address),
+			sizeof(subscriber.address), 0, 0) == 0;
+#else
+		iovec parts[2];
+		parts[0].iov_base = const_cast<TelemetryFrameHeader*>(&header);
+		parts[0].iov_len = sizeof(header);
+		parts[1].iov_base = const_cast<TelemetryEvent*>(events);
+		parts[1].iov_len = batch * sizeof(TelemetryEvent);
+		msghdr message;
+		std::memset(&message, 0, sizeof(message));
+		message.msg_name = &subscriber.address;
+		message.msg_namelen = sizeof(subscriber.address);
+		message.msg_iov = parts;
+		message.msg_iovlen = 2;
+		bool ok = sendmsg(socket, &message, 0) >= 0;
+#endif
+		subscriber.failures = ok ? 0 : subscriber.failures + 1;
+	}
+
+	Socket socket;
+	std::string token;
+	std::unique_ptr<char[]> ringMemory;
+	Rings* rings;
+	uint32_t sequence;
+	std::atomic<unsigned long long> dropped;
+	std::atomic<bool> stopping;
+	std::thread sender;
+
+	// The subscribers belong to the sender thread; subscriberCount is a copy of clientCount for other threads.
+	Subscriber clients[maxSubscribers];
+	unsigned clientCount;
+	std::atomic<unsigned> subscriberCount;
+};
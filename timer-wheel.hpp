@@ -0,0 +1,202 @@
+// A hashed timer wheel for scheduling work on the thread that runs the Myo event loop.
+#pragma once
+
+#include <chrono>
+#include <limits>
+#include <stdint.h>
+
+// timerClock() returns the time in milliseconds on the clock TimerWheel deadlines are measured against.
+inline uint64_t timerClock()
+{
+	return std::chrono::duration_cast<std::chrono::milliseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// TimerWheel keeps timers in slotCount lists by deadline modulo slotCount milliseconds, so scheduling and cancelling
+// are constant time and advance() only looks at the slots for the milliseconds that have passed. Timers are
+// intrusive: the wheel never allocates, and a Timer must stay alive while it is scheduled. Not thread-safe.
+class TimerWheel {
+public:
+	static const unsigned slotCount = 256;
+
+	// Timer is the base for anything that can be scheduled. expire() is called from advance() once the deadline has
+	// passed, and may schedule the timer again.
+	class Timer {
+	public:
+		Timer()
+			: deadline(0), next(0), prev(0), wheel(0)
+		{
+		}
+
+		virtual ~Timer()
+		{
+			if (wheel) {
+				wheel->cancel(*this);
+			}
+		}
+
+		virtual void expire(uint64_t now) = 0;
+
+		bool isScheduled() const
+		{
+			return wheel != 0;
+		}
+
+	private:
+		friend class TimerWheel;
+
+		uint64_t deadline;
+		Timer* next;
+		Timer* prev;
+		TimerWheel* wheel;
+	};
+
+	explicit TimerWheel(uint64_t now = timerClock())
+		: current(now), scheduled(0), earliest(0), earliestKnown(false)
+	{
+		for (unsigned i = 0; i < slotCount; ++i) {
+			slots[i] = 0;
+		}
+	}
+
+	// schedule() arranges for a timer to expire at `deadline`, replacing any earlier schedule. Deadlines that are not
+	// after the time the wheel was last advanced to expire a millisecond later, so a timer that reschedules itself from
+	// expire() can't keep advance() from returning.
+	void schedule(Timer& timer, uint64_t deadline)
+	{
+		cancel(timer);
+		timer.deadline = deadline <= current ? current + 1 : deadline;
+		link(timer);
+		if (scheduled == 0 || (earliestKnown && timer.deadline < earliest)) {
+			earliest = timer.deadline;
+			earliestKnown = true;
+		}
+		++scheduled;
+	}
+
+	void cancel(Timer& timer)
+	{
+		if (timer.wheel != this) {
+			return;
+		}
+		if (timer.deadline == earliest) {
+			earliestKnown = false;
+		}
+		unlink(timer);
+		--scheduled;
+	}
+
+	// timeUntilNext() returns how many milliseconds from `now` the earliest timer is due, 0 if one is overdue, or
+	// `idle` if nothing is scheduled. It is meant as the timeout for the next wait for events. The earliest deadline
+	// is kept from one call to the next, and only looked for again once the timer it belonged to has expired or been
+	// cancelled.
+	uint64_t timeUntilNext(uint64_t now, uint64_t idle) const
+	{
+		if (!scheduled) {
+			return idle;
+		}
+		if (!earliestKnown) {
+			earliest = findEarliest();
+			earliestKnown = true;
+		}
+		return earliest <= now ? 0 : (earliest - now < idle ? earliest - now : idle);
+	}
+
+	// advance() moves the wheel to `now` and expires every timer whose deadline has passed.
+	void advance(uint64_t now)
+	{
+		if (now < current) {
+			return;
+		}
+		// Each slot needs looking at once at most, however much time has passed.
+		uint64_t first = now - current >= slotCount ? now - slotCount + 1 : current;
+		current = now;
+		for (uint64_t tick = first; tick <= now; ++tick) {
+			expireSlot(static_cast<unsigned>(tick % slotCount), now);
+		}
+	}
+
+	unsigned size() const
+	{
+		return scheduled;
+	}
+
+private:
+	TimerWheel(const TimerWheel&);
+	TimerWheel& operator=(const TimerWheel&);
+
+	// findEarliest() returns the earliest deadline of the scheduled timers. Every deadline is after `current`, and the
+	// ones at most slotCount milliseconds after it each have a slot of their own millisecond, so the slots are looked at
+	// in order from there and the first timer due in the millisecond of its slot is the earliest. Only when nothing is
+	// due that soon are all the timers looked at.
+	uint64_t findEarliest() const
+	{
+		for (uint64_t tick = current + 1; tick <= current + slotCount; ++tick) {
+			for (Timer* timer = slots[tick % slotCount]; timer; timer = timer->next) {
+				if (timer->deadline == tick) {
+					return tick;
+				}
+			}
+		}
+		uint64_t found = std::numeric_limits<uint64_t>::max();
+		for (unsigned i = 0; i < slotCount; ++i) {
+			for (Timer* timer = slots[i]; timer; timer = timer->next) {
+				if (timer->deadline < found) {
+					found = timer->deadline;
+				}
+			}
+		}
+		return found;
+	}
+
+	// expireSlot() takes due timers out of the slot one at a time, so expire() is free to schedule or cancel any timer.
+	void expireSlot(unsigned slot, uint64_t now)
+	{
+		for (;;) {
+			Timer* timer = slots[slot];
+			while (timer && timer->deadline > now) {
+				timer = timer->next;
+			}
+			if (!timer) {
+				return;
+			}
+			cancel(*timer);
+			timer->expire(now);
+		}
+	}
+
+	void link(Timer& timer)
+	{
+		Timer*& head = slots[timer.deadline % slotCount];
+		timer.prev = 0;
+		timer.next = head;
+		if (head) {
+			head->prev = &timer;
+		}
+		head = &timer;
+		timer.wheel = this;
+	}
+
+	void unlink(Timer& timer)
+	{
+		if (timer.prev) {
+			timer.prev->next = timer.next;
+		}
+		else {
+			slots[timer.deadline % slotCount] = timer.next;
+		}
+		if (timer.next) {
+			timer.next->prev = timer.prev;
+		}
+		timer.next = timer.prev = 0;
+		timer.wheel = 0;
+	}
+
+	Timer* slots[slotCount];
+	uint64_t current;
+	unsigned scheduled;
+
+	// The earliest deadline, while earliestKnown is set; see timeUntilNext().
+	mutable uint64_t earliest;
+	mutable bool earliestKnown;
+};
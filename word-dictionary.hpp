@@ -0,0 +1,278 @@
+// Word prediction from a frequency-ranked dictionary, so a word can be finished with one gesture.
+#pragma once
+
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "mapped-file.hpp"
+
+// A dictionary file is a DictionaryHeader, nodeCount DictionaryNodes and then poolSize bytes of NUL-terminated words.
+// The nodes form a trie laid out breadth first, so the children of a node are contiguous and sorted by letter, and
+// node 0 is the root. Every node knows the most frequent word below it, which makes the suggestion for a prefix a
+// single lookup. Files are written by buildDictionary() in the host's (little-endian) byte order.
+struct DictionaryHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t nodeCount;
+	uint32_t poolSize;
+	uint32_t reserved;
+};
+
+struct DictionaryNode {
+	uint32_t firstChild;
+	// Offset in the pool of the most frequent word with this prefix, or noWord.
+	uint32_t best;
+	uint16_t childCount;
+	uint8_t letter;
+	uint8_t reserved;
+};
+
+static_assert(sizeof(DictionaryHeader) == 24 && sizeof(DictionaryNode) == 12, "dictionary files must keep their layout");
+
+const char dictionaryMagic[8] = { 'M', 'Y', 'O', 'D', 'I', 'C', 'T', '\0' };
+const uint32_t dictionaryVersion = 1;
+
+// WordDictionary is a dictionary file mapped into memory. Lookups read the mapping in place and never allocate. The
+// constructor throws std::runtime_error if the file is missing or malformed.
+class WordDictionary {
+public:
+	static const uint32_t noNode = 0xffffffff;
+	static const uint32_t noWord = 0xffffffff;
+
+	explicit WordDictionary(const std::string& path)
+		: file(path)
+	{
+		DictionaryHeader header;
+		if (file.size() < sizeof(header)) {
+			throw std::runtime_error(path + " is not a dictionary file");
+		}
+		std::memcpy(&header, file.data(), sizeof(header));
+		if (std::memcmp(header.magic, dictionaryMagic, sizeof(header.magic)) != 0 || header.version != dictionaryVersion
+			|| header.nodeCount == 0
+			|| file.size() != sizeof(header) + uint64_t(header.nodeCount) * sizeof(DictionaryNode) + header.poolSize) {
+			throw std::runtime_error(path + " is not a dictionary file this version can read");
+		}
+		nodeCount = header.nodeCount;
+		poolSize = header.poolSize;
+		nodes = file.data() + sizeof(header);
+		pool = reinterpret_cast<const char*>(nodes + nodeCount * sizeof(DictionaryNode));
+		if (poolSize == 0 || pool[poolSize - 1] != '\0') {
+			throw std::runtime_error(path + " has a truncated word pool");
+		}
+	}
+
+	uint32_t root() const
+	{
+		return 0;
+	}
+
+	// child() returns the node reached from `parent` by `letter`, or noNode.
+	uint32_t child(uint32_t parent, char letter) const
+	{
+		DictionaryNode node = at(parent);
+		for (uint32_t i = 0; i < node.childCount; ++i) {
+			uint32_t index = node.firstChild + i;
+			if (index >= nodeCount) {
+				break;
+			}
+			DictionaryNode candidate = at(index);
+			if (candidate.letter == static_cast<uint8_t>(letter)) {
+				return index;
+			}
+			if (candidate.letter > static_cast<uint8_t>(letter)) {
+				break;
+			}
+		}
+		return noNode;
+	}
+
+	// best() returns the most frequent word starting with the node's prefix, or null if there is none.
+	const char* best(uint32_t index) const
+	{
+		uint32_t offset = at(index).best;
+		return offset < poolSize ? pool + offset : 0;
+	}
+
+private:
+	DictionaryNode at(uint32_t index) const
+	{
+		// Nodes are copied out because the mapping gives no alignment guarantee for them.
+		DictionaryNode node;
+		std::memcpy(&node, nodes + index * sizeof(DictionaryNode), sizeof(node));
+		return node;
+	}
+
+	MappedFile file;
+	const unsigned char* nodes;
+	const char* pool;
+	uint32_t nodeCount, poolSize;
+};
+
+// WordPredictor follows the word being typed through a dictionary, one letter at a time, so the suggestion is always
+// ready without searching. A space starts a new word.
+class WordPredictor {
+public:
+	WordPredictor()
+		: dictionary(0), node(0), length(0)
+	{
+	}
+
+	void attach(const WordDictionary* words)
+	{
+		dictionary = words;
+		reset();
+	}
+
+	void reset()
+	{
+		node = dictionary ? dictionary->root() : WordDictionary::noNode;
+		length = 0;
+	}
+
+	// advance() moves to the prefix extended by `letter`. Once the prefix leaves the dictionary there are no more
+	// suggestions until the next space.
+	void advance(char letter)
+	{
+		if (letter == ' ') {
+			reset();
+			return;
+		}
+		++length;
+		if (dictionary && node != WordDictionary::noNode) {
+			node = dictionary->child(node, letter);
+		}
+	}
+
+	// suggestion() returns the most frequent word with the current prefix, or null if nothing has been typed yet or
+	// the dictionary has no such word.
+	const char* suggestion() const
+	{
+		if (!dictionary || node == WordDictionary::noNode || length == 0) {
+			return 0;
+		}
+		return dictionary->best(node);
+	}
+
+	// prefixLength() is how many letters of the current word have been typed.
+	unsigned prefixLength() const
+	{
+		return length;
+	}
+
+private:
+	const WordDictionary* dictionary;
+	uint32_t node;
+	unsigned length;
+};
+
+// buildDictionary() writes a dictionary file from a word list with one "word count" pair per line; a missing count
+// counts as 1, and a word listed twice adds up. When several words share a prefix, the most frequent one is suggested,
+// and of equally frequent ones the shortest, then the first alphabetically. It throws std::runtime_error on I/O
+// errors.
+inline void buildDictionary(const std::string& wordListPath, const std::string& outputPath)
+{
+	std::ifstream input(wordListPath.c_str());
+	if (!input) {
+		throw std::runtime_error("Unable to open word list " + wordListPath);
+	}
+	std::map<std::string, uint64_t> counts;
+	std::string line;
+	while (std::getline(input, line)) {
+		std::istringstream fields(line);
+		std::string word;
+		uint64_t count = 1;
+		if (!(fields >> word) || word[0] == '#') {
+			continue;
+		}
+		fields >> count;
+		counts[word] += count;
+	}
+
+	// Build the trie with explicit child maps, then lay it out breadth first.
+	struct BuildNode {
+		std::map<unsigned char, unsigned> children;
+		const std::string* best;
+		uint64_t bestCount;
+	};
+	std::vector<BuildNode> trie(1);
+	trie[0].best = 0;
+	trie[0].bestCount = 0;
+	for (std::map<std::string, uint64_t>::const_iterator i = counts.begin(); i != counts.end(); ++i) {
+		unsigned node = 0;
+		for (size_t depth = 0; depth <= i->first.size(); ++depth) {
+			BuildNode& here = trie[node];
+			if (!here.best || i->second > here.bestCount
+				|| (i->second == here.bestCount && i->first.size() < here.best->size())) {
+				here.best = &i->first;
+				here.bestCount = i->second;
+			}
+			if (depth == i->first.size()) {
+				break;
+			}
+			unsigned char letter = static_cast<unsigned char>(i->first[depth]);
+			std::map<unsigned char, unsigned>::iterator next = here.children.find(letter);
+			if (next == here.children.end()) {
+				unsigned created = static_cast<unsigned>(trie.size());
+				here.children[letter] = created;
+				BuildNode fresh;
+				fresh.best = 0;
+				fresh.bestCount = 0;
+				trie.push_back(fresh);
+				node = created;
+			}
+			else {
+				node = next->second;
+			}
+		}
+	}
+
+	std::map<const std::string*, uint32_t> offsets;
+	std::string pool;
+	for (std::map<std::string, uint64_t>::const_iterator i = counts.begin(); i != counts.end(); ++i) {
+		offsets[&i->first] = static_cast<uint32_t>(pool.size());
+		pool.append(i->first).push_back('\0');
+	}
+	if (pool.empty()) {
+		pool.push_back('\0');
+	}
+
+	std::vector<unsigned> order(1, 0);
+	std::vector<DictionaryNode> nodes;
+	std::vector<unsigned char> letters(1, 0);
+	for (size_t i = 0; i < order.size(); ++i) {
+		const BuildNode& here = trie[order[i]];
+		DictionaryNode node;
+		std::memset(&node, 0, sizeof(node));
+		node.firstChild = static_cast<uint32_t>(order.size());
+		node.childCount = static_cast<uint16_t>(here.children.size());
+		node.letter = letters[i];
+		node.best = here.best ? offsets[here.best] : WordDictionary::noWord;
+		nodes.push_back(node);
+		for (std::map<unsigned char, unsigned>::const_iterator child = here.children.begin(); child != here.children.end();
+			++child) {
+			order.push_back(child->second);
+			letters.push_back(child->first);
+		}
+	}
+
+	DictionaryHeader header;
+	std::memcpy(header.magic, dictionaryMagic, sizeof(header.magic));
+	header.version = dictionaryVersion;
+	header.nodeCount = static_cast<uint32_t>(nodes.size());
+	header.poolSize = static_cast<uint32_t>(pool.size());
+	header.reserved = 0;
+
+	std::ofstream output(outputPath.c_str(), std::ios::binary | std::ios::trunc);
+	output.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	output.write(reinterpret_cast<const char*>(&nodes[0]), nodes.size() * sizeof(DictionaryNode));
+	output.write(pool.data(), pool.size());
+	if (!output) {
+		throw std::runtime_error("Unable to write dictionary " + outputPath);
+	}
+}